@@ -0,0 +1,224 @@
+// lzpack: pack the loadable segments of an ELF binary into an LzImage
+// (see inc/lz.h), compressing each segment as one LZ4 block.
+//
+//	lzpack [-q] in.elf out.lz
+//
+// Prints the raw and packed sizes, unless -q.  The compressor is a greedy LZ77
+// matcher over hash chains; decoding speed, not ratio, is the point.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+// Use the host's fixed-width types instead of inc/types.h
+#define JOS_INC_TYPES_H
+#include <inc/elf.h>
+#include <inc/lz.h>
+
+#define ELF_PROG_LOAD	1
+
+#define MINMATCH	4
+#define MFLIMIT		12	// no match may start in the last 12 bytes
+#define LASTLITERALS	5	// ...or cover any of the last 5
+#define MAXOFF		65535
+#define HASHBITS	16
+#define MAXCHAIN	256	// candidates tried per position
+
+static int32_t head[1 << HASHBITS];
+static int32_t *chain;
+
+static void
+die(const char *fmt, const char *arg)
+{
+	fprintf(stderr, "lzpack: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+static uint32_t
+hash(const uint8_t *p)
+{
+	uint32_t x;
+
+	memcpy(&x, p, 4);
+	return (x * 2654435761U) >> (32 - HASHBITS);
+}
+
+static uint8_t *
+putlen(uint8_t *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+// Emit one sequence: the literals [lit, lit + nlit), then, if mlen is
+// nonzero, a match of mlen bytes at distance off.
+static uint8_t *
+putseq(uint8_t *op, const uint8_t *lit, size_t nlit, size_t off, size_t mlen)
+{
+	uint8_t *token = op++;
+
+	*token = (nlit < 15 ? nlit : 15) << 4;
+	if (nlit >= 15)
+		op = putlen(op, nlit - 15);
+	memcpy(op, lit, nlit);
+	op += nlit;
+	if (mlen == 0)
+		return op;
+
+	*op++ = off;
+	*op++ = off >> 8;
+	mlen -= MINMATCH;
+	*token |= mlen < 15 ? mlen : 15;
+	if (mlen >= 15)
+		op = putlen(op, mlen - 15);
+	return op;
+}
+
+static void
+insert(const uint8_t *in, size_t pos)
+{
+	uint32_t h = hash(in + pos);
+
+	chain[pos] = head[h];
+	head[h] = pos;
+}
+
+// Largest compressed size of n bytes
+static size_t
+lz_bound(size_t n)
+{
+	return n + n / 255 + 16;
+}
+
+// Compress n bytes at in into out, which must have room for
+// lz_bound(n) bytes.  Returns the compressed length.
+static size_t
+lz_encode(uint8_t *out, const uint8_t *in, size_t n)
+{
+	uint8_t *op = out;
+	size_t pos = 0, anchor = 0, limit, len, best, bestoff;
+	int32_t cand;
+	int tries;
+
+	if (n == 0)
+		return 0;
+	memset(head, 0xff, sizeof(head));
+	if (!(chain = realloc(chain, n * sizeof(chain[0]))))
+		die("%s", strerror(errno));
+
+	while (n >= MFLIMIT && pos <= n - MFLIMIT) {
+		limit = n - LASTLITERALS - pos;
+		best = 0;
+		bestoff = 0;
+		cand = head[hash(in + pos)];
+		for (tries = 0; cand >= 0 && pos - cand <= MAXOFF
+			     && tries < MAXCHAIN && best < limit;
+		     tries++, cand = chain[cand]) {
+			for (len = 0; len < limit && in[cand + len] == in[pos + len]; len++)
+				/* do nothing */;
+			if (len > best) {
+				best = len;
+				bestoff = pos - cand;
+			}
+		}
+		if (best < MINMATCH) {
+			insert(in, pos++);
+			continue;
+		}
+		op = putseq(op, in + anchor, pos - anchor, bestoff, best);
+		for (len = 0; len < best; len++)
+			if (pos + len <= n - MINMATCH)
+				insert(in, pos + len);
+		pos += best;
+		anchor = pos;
+	}
+	return putseq(op, in + anchor, n - anchor, 0, 0) - out;
+}
+
+static void *
+readfile(const char *name, size_t *size)
+{
+	FILE *f;
+	uint8_t *buf;
+	long n;
+
+	if (!(f = fopen(name, "rb")) || fseek(f, 0, SEEK_END) < 0
+	    || (n = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) < 0)
+		die("%s: cannot read", name);
+	if (!(buf = malloc(n)) || fread(buf, 1, n, f) != (size_t) n)
+		die("%s: cannot read", name);
+	fclose(f);
+	*size = n;
+	return buf;
+}
+
+int
+main(int argc, char **argv)
+{
+	uint8_t *elf, *out;
+	size_t elfsize, raw = 0, hdrsize, outsize, i;
+	struct Elf *eh;
+	struct Proghdr *ph;
+	struct LzImage *img;
+	struct LzSeg *ls;
+	FILE *f;
+	int quiet = 0;
+
+	if (argc > 1 && strcmp(argv[1], "-q") == 0)
+		quiet = 1, argc--, argv++;
+	if (argc != 3) {
+		fprintf(stderr, "usage: lzpack [-q] in.elf out.lz\n");
+		return 1;
+	}
+	elf = readfile(argv[1], &elfsize);
+	eh = (struct Elf *) elf;
+	if (elfsize < sizeof(*eh) || eh->e_magic != ELF_MAGIC
+	    || eh->e_phoff + eh->e_phnum * sizeof(*ph) > elfsize)
+		die("%s: not an ELF binary", argv[1]);
+
+	// The worst case is every segment incompressible
+	hdrsize = sizeof(*img) + eh->e_phnum * sizeof(*ls);
+	outsize = hdrsize;
+	ph = (struct Proghdr *) (elf + eh->e_phoff);
+	for (i = 0; i < eh->e_phnum; i++)
+		outsize += lz_bound(ph[i].p_filesz);
+	if (!(out = calloc(1, outsize)))
+		die("%s", strerror(errno));
+
+	img = (struct LzImage *) out;
+	img->lz_magic = LZ_MAGIC;
+	img->lz_entry = eh->e_entry;
+	outsize = hdrsize;
+	for (i = 0; i < eh->e_phnum; i++) {
+		if (ph[i].p_type != ELF_PROG_LOAD || ph[i].p_memsz == 0)
+			continue;
+		if (ph[i].p_offset + ph[i].p_filesz > elfsize
+		    || ph[i].p_filesz > ph[i].p_memsz)
+			die("%s: bad program header", argv[1]);
+		ls = &img->lz_seg[img->lz_nseg++];
+		ls->ls_va = ph[i].p_va;
+		ls->ls_pa = ph[i].p_pa;
+		ls->ls_filesz = ph[i].p_filesz;
+		ls->ls_memsz = ph[i].p_memsz;
+		ls->ls_off = outsize;
+		ls->ls_clen = lz_encode(out + outsize, elf + ph[i].p_offset,
+					ph[i].p_filesz);
+		outsize += ls->ls_clen;
+		raw += ph[i].p_filesz;
+	}
+
+	if (!(f = fopen(argv[2], "wb")) || fwrite(out, 1, outsize, f) != outsize
+	    || fclose(f) != 0)
+		die("%s: cannot write", argv[2]);
+	if (!quiet)
+		fprintf(stderr, "%s: %zu bytes in %u segments packed to %zu (%zu%%)\n",
+			argv[2], raw, img->lz_nseg, outsize,
+			raw ? outsize * 100 / raw : 100);
+	return 0;
+}
@@ -1,5 +1,6 @@
 #include <inc/x86.h>
 #include <inc/elf.h>
+#include <inc/memlayout.h>
 
 /**********************************************************************
  * This a dirt simple boot loader, whose sole job is to boot
@@ -11,7 +12,8 @@
  *
  *  * The 2nd sector onward holds the kernel image.
  *
- *  * The kernel image must be in ELF format.
+ *  * The kernel image must be in ELF format.  (In kernelz.img, that
+ *    "kernel" is boot/unpack, which carries the compressed kernel.)
  *
  * BOOT UP STEPS
  *  * when the CPU boots it loads the BIOS into memory and executes it
@@ -30,18 +32,22 @@
  **********************************************************************/
 
 #define SECTSIZE	512
+#define MAXSECTS	256	// most sectors one READ SECTORS can return
 #define ELFHDR		((struct Elf *) 0x10000) // scratch space
+#define SECTBUF		((uint8_t *) 0x11000)	 // one-sector scratch space
 
-void readsect(void*, uint32_t);
-void readseg(uint32_t, uint32_t, uint32_t);
+void readsects(void*, uint32_t, uint32_t);
+void readseg(struct Proghdr*);
 
 void
 bootmain(void)
 {
 	struct Proghdr *ph, *eph;
 
+	*(uint64_t *) BOOT_TSC = read_tsc();
+
 	// read 1st page off disk
-	readseg((uint32_t) ELFHDR, SECTSIZE*8, 0);
+	readsects(ELFHDR, 1, 8);
 
 	// is this a valid ELF?
 	if (ELFHDR->e_magic != ELF_MAGIC)
@@ -51,9 +57,7 @@ bootmain(void)
 	ph = (struct Proghdr *) ((uint8_t *) ELFHDR + ELFHDR->e_phoff);
 	eph = ph + ELFHDR->e_phnum;
 	for (; ph < eph; ph++)
-		// p_pa is the load address of this segment (as well
-		// as the physical address)
-		readseg(ph->p_pa, ph->p_memsz, ph->p_offset);
+		readseg(ph);
 
 	// call the entry point from the ELF header
 	// note: does not return!
@@ -66,33 +70,53 @@ bad:
 		/* do nothing */;
 }
 
-// Read 'count' bytes at 'offset' from kernel into physical address 'pa'.
-// Might copy more than asked
+// Load program segment 'ph' at its physical address p_pa (which is
+// also its load address).  Only the file part is on disk: read that,
+// then zero the rest (the BSS).  Might copy more than asked, past the
+// end of the segment; segments are loaded in increasing order, so
+// anything written there is either this segment's BSS or is loaded
+// again later.
 void
-readseg(uint32_t pa, uint32_t count, uint32_t offset)
+readseg(struct Proghdr *ph)
 {
-	uint32_t end_pa;
-
-	end_pa = pa + count;
+	uint32_t pa, end_pa, offset, n;
+	uint8_t *buf;
 
-	// round down to sector boundary
-	pa &= ~(SECTSIZE - 1);
+	pa = ph->p_pa;
+	end_pa = pa + ph->p_filesz;
 
 	// translate from bytes to sectors, and kernel starts at sector 1
-	offset = (offset / SECTSIZE) + 1;
-
-	// If this is too slow, we could read lots of sectors at a time.
-	// We'd write more to memory than asked, but it doesn't matter --
-	// we load in increasing order.
+	offset = (ph->p_offset / SECTSIZE) + 1;
+
+	// The first sector may be shared with the previous segment,
+	// which is already loaded (BSS and all) and may lie at a
+	// different distance from its disk bytes.  Read it aside and
+	// copy in just this segment's part, which leaves pa at the next
+	// sector boundary.
+	readsects(SECTBUF, offset++, 1);
+	buf = SECTBUF + pa % SECTSIZE;
+	n = SECTSIZE - pa % SECTSIZE;
+	asm volatile("rep movsb"
+		     : "+D" (pa), "+S" (buf), "+c" (n) : : "memory");
+
+	// Read contiguous runs of up to MAXSECTS sectors per command.
 	while (pa < end_pa) {
 		// Since we haven't enabled paging yet and we're using
 		// an identity segment mapping (see boot.S), we can
 		// use physical addresses directly.  This won't be the
 		// case once JOS enables the MMU.
-		readsect((uint8_t*) pa, offset);
-		pa += SECTSIZE;
-		offset++;
+		n = (end_pa - pa + SECTSIZE - 1) / SECTSIZE;
+		if (n > MAXSECTS)
+			n = MAXSECTS;
+		readsects((uint8_t*) pa, offset, n);
+		pa += n * SECTSIZE;
+		offset += n;
 	}
+
+	// zero the BSS
+	n = ph->p_memsz - ph->p_filesz;
+	asm volatile("rep stosb"
+		     : "+D" (end_pa), "+c" (n) : "a" (0) : "memory");
 }
 
 void
@@ -103,23 +127,27 @@ waitdisk(void)
 		/* do nothing */;
 }
 
+// Read 'n' (1 to MAXSECTS) consecutive sectors starting at 'offset'
+// with a single command.
 void
-readsect(void *dst, uint32_t offset)
+readsects(void *dst, uint32_t offset, uint32_t n)
 {
 	// wait for disk to be ready
 	waitdisk();
 
-	outb(0x1F2, 1);		// count = 1
+	outb(0x1F2, n);		// count; 0 means 256
 	outb(0x1F3, offset);
 	outb(0x1F4, offset >> 8);
 	outb(0x1F5, offset >> 16);
 	outb(0x1F6, (offset >> 24) | 0xE0);
 	outb(0x1F7, 0x20);	// cmd 0x20 - read sectors
 
-	// wait for disk to be ready
-	waitdisk();
+	do {
+		// wait for the next sector
+		waitdisk();
 
-	// read a sector
-	insl(0x1F0, dst, SECTSIZE/4);
+		// read a sector
+		insl(0x1F0, dst, SECTSIZE/4);
+		dst = (uint8_t *) dst + SECTSIZE;
+	} while (--n > 0);
 }
-
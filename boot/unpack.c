@@ -0,0 +1,51 @@
+#include <inc/x86.h>
+#include <inc/string.h>
+#include <inc/lz.h>
+
+/**********************************************************************
+ * Second stage of the compressed boot (obj/kern/kernelz.img).
+ *
+ * In that image the boot block loads this program, instead of the
+ * kernel, as "the kernel ELF image".  The kernel comes with it as an
+ * LzImage (see boot/lzpack.c) that unpack.ld places at PAYLOAD, above
+ * the largest kernel the entry page table can map.  unpack()
+ * decompresses each kernel segment to its load address, zeroes its
+ * BSS and jumps to the kernel's entry point, just as bootmain would
+ * after reading the uncompressed kernel.
+ *
+ * LZ4 decodes much faster than PIO can read the bytes it saves, so
+ * the kernel starts sooner.
+ **********************************************************************/
+
+extern uint8_t _binary_obj_kern_kernel_lz_start[];
+
+void
+unpack(void)
+{
+	struct LzImage *img = (struct LzImage *) _binary_obj_kern_kernel_lz_start;
+	struct LzSeg *ls;
+	uint32_t i;
+
+	if (img->lz_magic != LZ_MAGIC)
+		goto bad;
+
+	for (i = 0; i < img->lz_nseg; i++) {
+		ls = &img->lz_seg[i];
+		if (lz_decode((void *) ls->ls_pa, ls->ls_filesz,
+			      (uint8_t *) img + ls->ls_off, ls->ls_clen)
+		    != ls->ls_filesz)
+			goto bad;
+		memset((void *) (ls->ls_pa + ls->ls_filesz), 0,
+		       ls->ls_memsz - ls->ls_filesz);
+	}
+
+	// call the entry point from the ELF header
+	// note: does not return!
+	((void (*)(void)) (img->lz_entry))();
+
+bad:
+	outw(0x8A00, 0x8A00);
+	outw(0x8A00, 0x8E00);
+	while (1)
+		/* do nothing */;
+}
@@ -0,0 +1,30 @@
+#ifndef JOS_INC_CHAN_H
+#define JOS_INC_CHAN_H
+
+#include <inc/types.h>
+#include <inc/mmu.h>
+
+/*
+ * Shared-memory byte channel between two environments (see lib/chan.c).
+ *
+ * A channel is a header page followed by a power-of-two number of data pages,
+ * all mapped PTE_SHARE at the same address in both environments.  The
+ * writer advances 'tail' and the reader advances 'head'; the indices
+ * are free-running byte counts, and 'size' is a power of two.  While
+ * the ring is neither empty nor full, neither side makes a system
+ * call.  A side that must wait publishes its envid in rwaiter/wwaiter
+ * and sleeps in sys_notify_wait; the other side wakes it with
+ * sys_notify when it next moves its index.
+ */
+struct Chan {
+	volatile uint32_t head;		// next byte to read
+	volatile uint32_t tail;		// next byte to write
+	volatile envid_t rwaiter;	// reader waiting for data, or 0
+	volatile envid_t wwaiter;	// writer waiting for space, or 0
+	volatile uint32_t closed;	// writer has closed the channel
+	uint32_t size;			// bytes in the data area
+	uint8_t pad[PGSIZE - 6 * sizeof(uint32_t)];
+	uint8_t data[];			// 'size' bytes
+};
+
+#endif	// !JOS_INC_CHAN_H
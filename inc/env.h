@@ -43,6 +43,15 @@ enum EnvType {
 	ENV_TYPE_USER = 0,
 };
 
+// Per-environment data page, mapped read-only at UVDSO.  The kernel
+// keeps it current so user code can read these without trapping.
+struct Vdso {
+	envid_t vd_envid;		// This environment's env_id
+	uint32_t vd_ticks;		// Scheduler dispatches (env_run calls)
+	uint32_t vd_tsc_khz;		// TSC ticks per millisecond
+	uint64_t vd_tsc_boot;		// TSC value at boot
+};
+
 struct Env {
 	struct Trapframe env_tf;	// Saved registers
 	struct Env *env_link;		// Next free Env
@@ -54,6 +63,21 @@ struct Env {
 
 	// Address space
 	pde_t *env_pgdir;		// Kernel virtual address of page dir
+	struct Vdso *env_vdso;		// Kernel virtual address of UVDSO page
+
+	// Exception handling
+	void *env_pgfault_upcall;	// Page fault upcall entry point
+
+	// IPC
+	bool env_ipc_recving;		// Env is blocked receiving
+	void *env_ipc_dstva;		// VA at which to map received page
+	uint32_t env_ipc_value;		// Data value sent to us
+	envid_t env_ipc_from;		// envid of the sender
+	int env_ipc_perm;		// Perm of page mapping received
+	envid_t env_ipc_waitfor;	// Only accept from this env, if nonzero
+	bool env_ipc_regs;		// Deliver the message in registers too
+	bool env_notify_waiting;	// Env is blocked in sys_notify_wait
+	bool env_notify_pending;	// sys_notify came while not waiting
 };
 
 #endif // !JOS_INC_ENV_H
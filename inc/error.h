@@ -14,6 +14,7 @@ enum {
 				// the maximum allowed
 	E_FAULT		= 6,	// Memory fault
 	E_NO_SYS	= 7,	// Unimplemented system call
+	E_IPC_NOT_RECV	= 8,	// Attempt to send to env that is not recving
 
 	MAXERROR
 };
@@ -16,6 +16,7 @@
 #include <inc/env.h>
 #include <inc/memlayout.h>
 #include <inc/syscall.h>
+#include <inc/chan.h>
 
 #define USED(x)		(void)(x)
 
@@ -27,10 +28,21 @@ extern const char *binaryname;
 extern const volatile struct Env *thisenv;
 extern const volatile struct Env envs[NENV];
 extern const volatile struct PageInfo pages[];
+extern const volatile struct Vdso vdso;
 
 // exit.c
 void	exit(void);
 
+// console.c
+#define CBUF_NONE	0	// flush after every call
+#define CBUF_LINE	1	// flush after calls that write a newline
+#define CBUF_FULL	2	// flush only when the buffer fills
+void	cwrite(const char *s, size_t len);
+void	cflush(void);
+int	csetbuf(int mode);
+void	cbegin(void);
+void	cend(void);
+
 // readline.c
 char*	readline(const char *buf);
 
@@ -39,6 +51,66 @@ void	sys_cputs(const char *string, size_t len);
 int	sys_cgetc(void);
 envid_t	sys_getenvid(void);
 int	sys_env_destroy(envid_t);
+int	sys_submit(void);
+int	sys_page_alloc(envid_t env, void *pg, int perm);
+int	sys_env_set_pgfault_upcall(envid_t env, void *upcall);
+void	sys_yield(void);
+static envid_t sys_exofork(void);
+int	sys_env_set_status(envid_t env, int status);
+int	sys_page_map(envid_t src_env, void *src_pg,
+		     envid_t dst_env, void *dst_pg, int perm);
+int	sys_page_unmap(envid_t env, void *pg);
+int	sys_ipc_try_send(envid_t to_env, uint32_t value, void *pg, int perm);
+int	sys_ipc_recv(void *rcv_pg);
+int	sys_ipc_call(envid_t to_env, uint32_t *value, void *pg, int *perm,
+		     void *rcv_pg);
+int	sys_ipc_reply_wait(envid_t to_env, uint32_t *value, void *pg,
+			   int *perm, void *rcv_pg);
+int	sys_notify_wait(const volatile uint32_t *addr, uint32_t val);
+int	sys_notify(envid_t envid);
+
+// This must be inlined.  Exercise for reader: why?
+static inline envid_t __attribute__((always_inline))
+sys_exofork(void)
+{
+	envid_t ret;
+	asm volatile("int %2"
+		     : "=a" (ret)
+		     : "a" (SYS_exofork), "i" (T_SYSCALL));
+	return ret;
+}
+
+// ipc.c
+void	ipc_send(envid_t to_env, uint32_t value, void *pg, int perm);
+int32_t ipc_recv(envid_t *from_env_store, void *pg, int *perm_store);
+envid_t	ipc_find_env(enum EnvType type);
+int32_t	ipc_call(envid_t to_env, uint32_t value, void *pg, int perm,
+		 int *perm_store);
+int32_t	ipc_reply_wait(envid_t to_env, uint32_t value, void *pg, int perm,
+		       envid_t *from_env_store, int *perm_store);
+
+// chan.c
+int	chan_create(struct Chan *c, size_t npages);
+int	chan_share(struct Chan *c, envid_t envid);
+ssize_t	chan_send(struct Chan *c, const void *buf, size_t n);
+ssize_t	chan_recv(struct Chan *c, void *buf, size_t n);
+void	chan_close(struct Chan *c);
+
+// fork.c
+#define	PTE_SHARE	0x400
+envid_t	fork(void);
+
+// pgfault.c
+void	set_pgfault_handler(void (*handler)(struct UTrapframe *utf));
+
+// vdso.c
+uint64_t vdso_time_usec(void);
+uint32_t vdso_ticks(void);
+
+// sysring.c
+int	sysring_queue(int num, uint32_t a1, uint32_t a2, uint32_t a3,
+		      uint32_t a4, uint32_t a5, uint32_t data);
+int	sysring_reap(int32_t *ret, uint32_t *data);
 
 
 
@@ -0,0 +1,30 @@
+#ifndef JOS_INC_LZ_H
+#define JOS_INC_LZ_H
+
+#include <inc/types.h>
+
+// A packed ELF image, as written by boot/lzpack: the loadable segments
+// of an ELF binary, each compressed as one LZ4 block.  The image starts
+// with a struct LzImage, followed by lz_nseg struct LzSegs.
+
+#define LZ_MAGIC 0x4B505A4CU	/* "LZPK" in little endian */
+
+struct LzSeg {
+	uint32_t ls_va;		// virtual address
+	uint32_t ls_pa;		// physical (load) address
+	uint32_t ls_filesz;	// bytes that ls_clen decompresses to
+	uint32_t ls_memsz;	// zero-filled beyond ls_filesz
+	uint32_t ls_off;	// offset of compressed bytes in the image
+	uint32_t ls_clen;	// compressed length
+};
+
+struct LzImage {
+	uint32_t lz_magic;	// must equal LZ_MAGIC
+	uint32_t lz_entry;	// ELF entry point
+	uint32_t lz_nseg;
+	struct LzSeg lz_seg[];
+};
+
+int	lz_decode(void *dst, size_t dstlen, const void *src, size_t srclen);
+
+#endif /* !JOS_INC_LZ_H */
@@ -70,6 +70,10 @@
  *    PFTEMP ------->  |       Empty Memory (*)       |        PTSIZE
  *                     |                              |
  *    UTEMP -------->  +------------------------------+ 0x00400000      --+
+ *                     |     Syscall Ring (User RW)   | RW/RW  PGSIZE     |
+ *    USYSRING ----->  +------------------------------+ 0x003ff000        |
+ *                     |   Kernel Data Page (User R-) | R-/R-  PGSIZE     |
+ *    UVDSO -------->  +------------------------------+ 0x003fe000        |
  *                     |       Empty Memory (*)       |                   |
  *                     | - - - - - - - - - - - - - - -|                   |
  *                     |  User STAB Data (optional)   |                 PTSIZE
@@ -92,6 +96,11 @@
 #define IOPHYSMEM	0x0A0000
 #define EXTPHYSMEM	0x100000
 
+// The boot loader leaves the TSC value at entry to bootmain here (a
+// uint64_t in free low memory, below its stack), so the kernel can
+// report how long loading took.
+#define BOOT_TSC	0x7000
+
 // Kernel stack.
 #define KSTACKTOP	KERNBASE
 #define KSTKSIZE	(8*PGSIZE)   		// size of a kernel stack
@@ -137,6 +146,10 @@
 #define PFTEMP		(UTEMP + PTSIZE - PGSIZE)
 // The location of the user-level STABS data structure
 #define USTABDATA	(PTSIZE / 2)
+// The batched system call ring (struct Sysring, inc/syscall.h)
+#define USYSRING	(PTSIZE - PGSIZE)
+// The read-only per-environment kernel data page (struct Vdso, inc/env.h)
+#define UVDSO		(USYSRING - PGSIZE)
 
 #ifndef __ASSEMBLER__
 
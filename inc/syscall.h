@@ -1,13 +1,60 @@
 #ifndef JOS_INC_SYSCALL_H
 #define JOS_INC_SYSCALL_H
 
+#include <inc/types.h>
+
 /* system call numbers */
 enum {
 	SYS_cputs = 0,
 	SYS_cgetc,
 	SYS_getenvid,
 	SYS_env_destroy,
+	SYS_submit,
+	SYS_page_alloc,
+	SYS_env_set_pgfault_upcall,
+	SYS_exofork,
+	SYS_env_set_status,
+	SYS_page_map,
+	SYS_page_unmap,
+	SYS_yield,
+	SYS_ipc_try_send,
+	SYS_ipc_recv,
+	SYS_ipc_call,
+	SYS_ipc_reply_wait,
+	SYS_notify_wait,
+	SYS_notify,
 	NSYSCALLS
 };
 
+/*
+ * Batched system call ring, mapped read/write into every environment
+ * at USYSRING.  The environment fills submission entries and advances
+ * sq_tail; SYS_submit then runs entries [sq_head, sq_tail) in order,
+ * writing one completion per entry and advancing sq_head and cq_tail.
+ * The environment consumes completions by advancing cq_head.
+ * Indices are free-running; use SYSRING_MASK to get a slot.
+ */
+#define SYSRING_NENT	64
+#define SYSRING_MASK	(SYSRING_NENT - 1)
+
+struct SysSqe {
+	uint32_t num;		// SYS_* number
+	uint32_t args[5];	// same registers as the trap interface
+	uint32_t data;		// opaque, copied to the completion
+};
+
+struct SysCqe {
+	uint32_t data;		// from the matching submission
+	int32_t ret;		// system call return value
+};
+
+struct Sysring {
+	volatile uint32_t sq_head;	// advanced by the kernel
+	volatile uint32_t sq_tail;	// advanced by the environment
+	volatile uint32_t cq_head;	// advanced by the environment
+	volatile uint32_t cq_tail;	// advanced by the kernel
+	struct SysSqe sq[SYSRING_NENT];
+	struct SysCqe cq[SYSRING_NENT];
+};
+
 #endif /* !JOS_INC_SYSCALL_H */
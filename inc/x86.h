@@ -34,6 +34,9 @@ static __inline uint32_t read_ebp(void) __attribute__((always_inline));
 static __inline uint32_t read_esp(void) __attribute__((always_inline));
 static __inline void cpuid(uint32_t info, uint32_t *eaxp, uint32_t *ebxp, uint32_t *ecxp, uint32_t *edxp);
 static __inline uint64_t read_tsc(void) __attribute__((always_inline));
+static __inline void clts(void) __attribute__((always_inline));
+static __inline void fxsave(void *area) __attribute__((always_inline));
+static __inline void fxrstor(const void *area) __attribute__((always_inline));
 
 static __inline void
 breakpoint(void)
@@ -280,6 +283,25 @@ read_tsc(void)
 	return tsc;
 }
 
+static __inline void
+clts(void)
+{
+	__asm __volatile("clts");
+}
+
+// 'area' must be 512 bytes, 16-byte aligned
+static __inline void
+fxsave(void *area)
+{
+	__asm __volatile("fxsave (%0)" : : "r" (area) : "memory");
+}
+
+static __inline void
+fxrstor(const void *area)
+{
+	__asm __volatile("fxrstor (%0)" : : "r" (area) : "memory");
+}
+
 static inline uint32_t
 xchg(volatile uint32_t *addr, uint32_t newval)
 {
@@ -5,11 +5,14 @@
 #include <inc/kbdreg.h>
 #include <inc/string.h>
 #include <inc/assert.h>
+#include <inc/trap.h>
 
 #include <kern/console.h>
+#include <kern/picirq.h>
 
 static void cons_intr(int (*proc)(void));
 static void cons_putc(int c);
+static void cons_drain(bool synchronous);
 
 // Stupid I/O delay routine necessitated by historical PC design flaws
 static void
@@ -21,6 +24,48 @@ delay(void)
 	inb(0x84);
 }
 
+/***** Console output ring *****/
+// All console output goes into one ring, shared by the output devices
+// ("sinks").  Each sink has its own read index and takes bytes from
+// the ring whenever its device is ready, so a slow or absent device
+// does not hold up the others.  The indices are free-running.
+
+#define CONS_OUTSIZE	1024
+
+static struct {
+	uint8_t buf[CONS_OUTSIZE];
+	uint32_t wpos;
+} cons_out;
+
+struct ConsSink {
+	const char *name;
+	bool enabled;		// device detected
+	uint32_t rpos;		// next byte in cons_out for this device
+	// Write as much as the device will take right now.
+	void (*drain)(struct ConsSink *s);
+	// Wait until the device will take more; return 0 on timeout.
+	// Null for sinks that drop output rather than wait.
+	bool (*wait)(void);
+	uint32_t bytes;		// bytes written to the device
+	uint32_t stalls;	// times output waited for the device
+	uint32_t drops;		// bytes dropped for the device
+};
+
+static struct ConsSink serial_sink, lpt_sink, cga_sink;
+
+static inline bool
+sink_pending(struct ConsSink *s)
+{
+	return s->rpos != cons_out.wpos;
+}
+
+static inline uint8_t
+sink_getc(struct ConsSink *s)
+{
+	s->bytes++;
+	return cons_out.buf[s->rpos++ % CONS_OUTSIZE];
+}
+
 /***** Serial I/O code *****/
 
 #define COM1		0x3F8
@@ -31,8 +76,17 @@ delay(void)
 #define COM_DLM		1	// Out: Divisor Latch High (DLAB=1)
 #define COM_IER		1	// Out: Interrupt Enable Register
 #define   COM_IER_RDI	0x01	//   Enable receiver data interrupt
+#define   COM_IER_TXI	0x02	//   Enable transmitter empty interrupt
 #define COM_IIR		2	// In:	Interrupt ID Register
+#define   COM_IIR_ID	0x0F	//   Interrupt identification
+#define   COM_IIR_RDA	0x04	//   Receive FIFO at trigger level
+#define   COM_IIR_FIFO	0xC0	//   FIFOs enabled
 #define COM_FCR		2	// Out: FIFO Control Register
+#define   COM_FCR_ENABLE 0x01	//   Enable the FIFOs
+#define   COM_FCR_RCLR	0x02	//   Clear the receive FIFO
+#define   COM_FCR_TCLR	0x04	//   Clear the transmit FIFO
+#define   COM_FCR_TRIG(n) (((n) == 14 ? 3 : (n) == 8 ? 2 : (n) == 4 ? 1 : 0) << 6)
+				//   Receive trigger level: 1, 4, 8 or 14 bytes
 #define COM_LCR		3	// Out: Line Control Register
 #define	  COM_LCR_DLAB	0x80	//   Divisor latch access bit
 #define	  COM_LCR_WLEN8	0x03	//   Wordlength: 8 bits
@@ -45,25 +99,95 @@ delay(void)
 #define   COM_LSR_TXRDY	0x20	//   Transmit buffer avail
 #define   COM_LSR_TSRE	0x40	//   Transmitter off
 
+#define COM_FIFO_SIZE	16	// 16550 transmit FIFO depth
+#define COM_BASE_BAUD	115200	// Divisor 1
+
+// Line speed and receive FIFO trigger level; override with -D.
+// SERIAL_BAUD must divide COM_BASE_BAUD, and SERIAL_RX_TRIGGER must be
+// 1, 4, 8 or 14.  A higher trigger level means
+// fewer receive interrupts but less slack before the FIFO overruns.
+#ifndef SERIAL_BAUD
+#define SERIAL_BAUD	115200
+#endif
+#ifndef SERIAL_RX_TRIGGER
+#define SERIAL_RX_TRIGGER 8
+#endif
+
 static bool serial_exists;
 
+// Serial output is taken from the console output ring COM_FIFO_SIZE
+// bytes at a time, whenever the UART's transmit FIFO is empty: from
+// cons_putc, or from the UART's transmitter-empty interrupt (IRQ 4).
+static int serial_tx_burst;	// bytes per empty transmit FIFO
+static uint8_t serial_ier;	// current COM_IER value
+
+// Number of bytes a receive-data interrupt guarantees are waiting.
+static int serial_rx_trigger;
+
+// Read what the UART has received into 'buf', up to COM_FIFO_SIZE
+// bytes, and return how many.  If the receive FIFO has reached its
+// trigger level, that many bytes are read without polling LSR before
+// each one.
+static int
+serial_rx(uint8_t *buf)
+{
+	int n = 0;
+
+	if ((inb(COM1+COM_IIR) & COM_IIR_ID) == COM_IIR_RDA)
+		for (; n < serial_rx_trigger; n++)
+			buf[n] = inb(COM1+COM_RX);
+	while (n < COM_FIFO_SIZE && (inb(COM1+COM_LSR) & COM_LSR_DATA))
+		buf[n++] = inb(COM1+COM_RX);
+	return n;
+}
+
+// Return the next received byte, or -1 if none.  Drains the UART's
+// receive FIFO a batch at a time.
 static int
 serial_proc_data(void)
 {
-	if (!(inb(COM1+COM_LSR) & COM_LSR_DATA))
-		return -1;
-	return inb(COM1+COM_RX);
+	static uint8_t rxbuf[COM_FIFO_SIZE];
+	static int rxpos, rxlen;
+
+	if (rxpos == rxlen) {
+		rxpos = 0;
+		if ((rxlen = serial_rx(rxbuf)) == 0)
+			return -1;
+	}
+	return rxbuf[rxpos++];
+}
+
+// Refill the UART from the output ring if its FIFO is empty, and
+// ask for an interrupt when it empties again if more is queued.
+static void
+serial_drain(struct ConsSink *s)
+{
+	uint8_t ier;
+	int n;
+
+	if (sink_pending(s) && (inb(COM1 + COM_LSR) & COM_LSR_TXRDY))
+		for (n = 0; n < serial_tx_burst && sink_pending(s); n++)
+			outb(COM1 + COM_TX, sink_getc(s));
+
+	ier = COM_IER_RDI;
+	if (sink_pending(s))
+		ier |= COM_IER_TXI;
+	if (ier != serial_ier)
+		outb(COM1 + COM_IER, serial_ier = ier);
 }
 
 void
 serial_intr(void)
 {
-	if (serial_exists)
+	if (serial_exists) {
 		cons_intr(serial_proc_data);
+		serial_drain(&serial_sink);
+	}
 }
 
-static void
-serial_putc(int c)
+// Wait for the UART to take the next character.
+static bool
+serial_wait(void)
 {
 	int i;
 
@@ -71,35 +195,53 @@ serial_putc(int c)
 	     !(inb(COM1 + COM_LSR) & COM_LSR_TXRDY) && i < 12800;
 	     i++)
 		delay();
-
-	outb(COM1 + COM_TX, c);
+	return i < 12800;
 }
 
 static void
 serial_init(void)
 {
-	// Turn off the FIFO
-	outb(COM1+COM_FCR, 0);
+	static_assert(COM_BASE_BAUD % SERIAL_BAUD == 0);
+	static_assert(SERIAL_RX_TRIGGER == 1 || SERIAL_RX_TRIGGER == 4 ||
+		      SERIAL_RX_TRIGGER == 8 || SERIAL_RX_TRIGGER == 14);
+
+	// Turn on and clear the FIFOs, so that each transmitter-empty
+	// interrupt can take a burst of output, and each receive
+	// interrupt a batch of input
+	outb(COM1+COM_FCR, COM_FCR_ENABLE | COM_FCR_RCLR | COM_FCR_TCLR |
+	     COM_FCR_TRIG(SERIAL_RX_TRIGGER));
 
 	// Set speed; requires DLAB latch
 	outb(COM1+COM_LCR, COM_LCR_DLAB);
-	outb(COM1+COM_DLL, (uint8_t) (115200 / 9600));
-	outb(COM1+COM_DLM, 0);
+	outb(COM1+COM_DLL, (uint8_t) (COM_BASE_BAUD / SERIAL_BAUD));
+	outb(COM1+COM_DLM, (uint8_t) ((COM_BASE_BAUD / SERIAL_BAUD) >> 8));
 
 	// 8 data bits, 1 stop bit, parity off; turn off DLAB latch
 	outb(COM1+COM_LCR, COM_LCR_WLEN8 & ~COM_LCR_DLAB);
 
 	// No modem controls
 	outb(COM1+COM_MCR, 0);
-	// Enable rcv interrupts
+	// Enable rcv interrupts; transmit interrupts are enabled only
+	// while the transmit ring is nonempty
 	outb(COM1+COM_IER, COM_IER_RDI);
+	serial_ier = COM_IER_RDI;
 
 	// Clear any preexisting overrun indications and interrupts
 	// Serial port doesn't exist if COM_LSR returns 0xFF
 	serial_exists = (inb(COM1+COM_LSR) != 0xFF);
-	(void) inb(COM1+COM_IIR);
+	// An 8250 or 16450 has no FIFO: one byte at a time
+	if ((inb(COM1+COM_IIR) & COM_IIR_FIFO) == COM_IIR_FIFO) {
+		serial_tx_burst = COM_FIFO_SIZE;
+		serial_rx_trigger = SERIAL_RX_TRIGGER;
+	} else {
+		serial_tx_burst = 1;
+		serial_rx_trigger = 1;
+	}
 	(void) inb(COM1+COM_RX);
 
+	serial_sink.enabled = serial_exists;
+	if (serial_exists)
+		irq_setmask_8259A(irq_mask_8259A & ~(1<<IRQ_SERIAL));
 }
 
 
@@ -108,16 +250,38 @@ serial_init(void)
 // For information on PC parallel port programming, see the class References
 // page.
 
+#define LPT1		0x378
+#define LPT_DATA	0	// Data port
+#define LPT_STATUS	1	// In:	Status port
+#define   LPT_STATUS_NBUSY 0x80	//   Printer not busy
+#define LPT_CTRL	2	// Out: Control port
+
+// Hand the printer whatever it will take without waiting.  The
+// parallel port has no interrupt here, so this runs whenever the
+// console is written or polled; output that falls a whole ring
+// behind is dropped.
 static void
-lpt_putc(int c)
+lpt_drain(struct ConsSink *s)
 {
-	int i;
+	while (sink_pending(s) && (inb(LPT1+LPT_STATUS) & LPT_STATUS_NBUSY)) {
+		outb(LPT1+LPT_DATA, sink_getc(s));
+		outb(LPT1+LPT_CTRL, 0x08|0x04|0x01);
+		outb(LPT1+LPT_CTRL, 0x08);
+	}
+}
 
-	for (i = 0; !(inb(0x378+1) & 0x80) && i < 12800; i++)
-		delay();
-	outb(0x378+0, c);
-	outb(0x378+2, 0x08|0x04|0x01);
-	outb(0x378+2, 0x08);
+static void
+lpt_init(void)
+{
+	// The data port latches what we write; with no port present
+	// the bus floats and reads back 0xFF.
+	outb(LPT1+LPT_DATA, 0xAA);
+	if (inb(LPT1+LPT_DATA) != 0xAA)
+		return;
+	outb(LPT1+LPT_DATA, 0x55);
+	if (inb(LPT1+LPT_DATA) != 0x55)
+		return;
+	lpt_sink.enabled = 1;
 }
 
 
@@ -125,9 +289,31 @@ lpt_putc(int c)
 
 /***** Text-mode CGA/VGA display output *****/
 
+// The screen is a CRT_SIZE window onto a larger text buffer in video
+// memory, starting at cell crt_start.  Scrolling moves the window
+// down a line with the 6845's start address register rather than
+// copying the screen; only when the window reaches the end of the
+// buffer is the screen copied back to the top.  crt_pos and
+// crt_start are cell indices into the whole buffer.
+#define CGA_BUF_CELLS	8192	// 16KB of color text memory
+#define CRT_REG_START	12	// 6845 start address (high; low is 13)
+#define CRT_REG_CURSOR	14	// 6845 cursor address (high; low is 15)
+
 static unsigned addr_6845;
 static uint16_t *crt_buf;
 static uint16_t crt_pos;
+static uint16_t crt_start;
+static uint16_t crt_cells;	// size of the text buffer
+
+// Set a 16-bit 6845 register pair.
+static void
+crt_setreg(int reg, uint16_t val)
+{
+	outb(addr_6845, reg);
+	outb(addr_6845 + 1, val >> 8);
+	outb(addr_6845, reg + 1);
+	outb(addr_6845 + 1, val);
+}
 
 static void
 cga_init(void)
@@ -142,9 +328,12 @@ cga_init(void)
 	if (*cp != 0xA55A) {
 		cp = (uint16_t*) (KERNBASE + MONO_BUF);
 		addr_6845 = MONO_BASE;
+		// An MDA has only one screen of memory: scroll by copying.
+		crt_cells = CRT_SIZE;
 	} else {
 		*cp = was;
 		addr_6845 = CGA_BASE;
+		crt_cells = CGA_BUF_CELLS;
 	}
 
 	/* Extract cursor location */
@@ -154,58 +343,99 @@ cga_init(void)
 	pos |= inb(addr_6845 + 1);
 
 	crt_buf = (uint16_t*) cp;
-	crt_pos = pos;
+	crt_pos = pos < CRT_SIZE ? pos : 0;
+	crt_start = 0;
+	crt_setreg(CRT_REG_START, crt_start);
+	cga_sink.enabled = 1;
 }
 
+// Scroll until crt_pos is back on the screen.
+static void
+cga_scroll(void)
+{
+	int i;
 
+	while (crt_pos >= crt_start + CRT_SIZE) {
+		if (crt_start + CRT_SIZE + CRT_COLS > crt_cells) {
+			// Out of buffer: copy all but the top line back
+			// to the start of the buffer.
+			memmove(crt_buf, crt_buf + crt_start + CRT_COLS,
+				(CRT_SIZE - CRT_COLS) * sizeof(uint16_t));
+			crt_pos -= crt_start + CRT_COLS;
+			crt_start = 0;
+		} else
+			crt_start += CRT_COLS;
+		for (i = crt_start + CRT_SIZE - CRT_COLS; i < crt_start + CRT_SIZE; i++)
+			crt_buf[i] = 0x0700 | ' ';
+	}
+}
 
+// Write 'len' characters to the screen with attribute 'attr' (in the
+// high byte; 0x0700 is black on white).  Runs of ordinary characters
+// are stored straight into video memory; the start address and cursor
+// are sent to the 6845 once per call.
 static void
-cga_putc(int c)
+cga_write(const uint8_t *buf, size_t len, uint16_t attr)
 {
-	// if no attribute given, then use black on white
-	if (!(c & ~0xFF))
-		c |= 0x0700;
+	const uint8_t *end = buf + len;
+	uint16_t start = crt_start;
+	int i;
 
-	switch (c & 0xff) {
-	case '\b':
-		if (crt_pos > 0) {
-			crt_pos--;
-			crt_buf[crt_pos] = (c & ~0xff) | ' ';
+	while (buf < end) {
+		switch (*buf) {
+		case '\b':
+			if (crt_pos > crt_start) {
+				crt_pos--;
+				crt_buf[crt_pos] = attr | ' ';
+			}
+			break;
+		case '\n':
+			crt_pos += CRT_COLS;
+			/* fallthru */
+		case '\r':
+			crt_pos -= (crt_pos % CRT_COLS);
+			break;
+		case '\t':
+			// Expand on the display only; the other sinks get the tab.
+			for (i = 0; i < 5; i++) {
+				crt_buf[crt_pos++] = attr | ' ';
+				cga_scroll();
+			}
+			break;
+		default:
+			// Store a run of ordinary characters, up to the end
+			// of the screen.
+			while (buf < end && *buf != '\b' && *buf != '\n' &&
+			       *buf != '\r' && *buf != '\t' &&
+			       crt_pos < crt_start + CRT_SIZE)
+				crt_buf[crt_pos++] = attr | *buf++;
+			cga_scroll();
+			continue;
 		}
-		break;
-	case '\n':
-		crt_pos += CRT_COLS;
-		/* fallthru */
-	case '\r':
-		crt_pos -= (crt_pos % CRT_COLS);
-		break;
-	case '\t':
-		cons_putc(' ');
-		cons_putc(' ');
-		cons_putc(' ');
-		cons_putc(' ');
-		cons_putc(' ');
-		break;
-	default:
-		crt_buf[crt_pos++] = c;		/* write the character */
-		break;
+		buf++;
+		cga_scroll();
 	}
 
-	// What is the purpose of this?
-	if (crt_pos >= CRT_SIZE) {
-		int i;
+	if (crt_start != start)
+		crt_setreg(CRT_REG_START, crt_start);
+	/* move that little blinky thing */
+	crt_setreg(CRT_REG_CURSOR, crt_pos);
+}
 
-		memmove(crt_buf, crt_buf + CRT_COLS, (CRT_SIZE - CRT_COLS) * sizeof(uint16_t));
-		for (i = CRT_SIZE - CRT_COLS; i < CRT_SIZE; i++)
-			crt_buf[i] = 0x0700 | ' ';
-		crt_pos -= CRT_COLS;
+// The display is memory: it always takes everything, a contiguous
+// span of the ring at a time.
+static void
+cga_drain(struct ConsSink *s)
+{
+	uint32_t off, n;
+
+	while (sink_pending(s)) {
+		off = s->rpos % CONS_OUTSIZE;
+		n = MIN(cons_out.wpos - s->rpos, CONS_OUTSIZE - off);
+		cga_write(cons_out.buf + off, n, 0x0700);
+		s->rpos += n;
+		s->bytes += n;
 	}
-
-	/* move that little blinky thing */
-	outb(addr_6845, 14);
-	outb(addr_6845 + 1, crt_pos >> 8);
-	outb(addr_6845, 15);
-	outb(addr_6845 + 1, crt_pos);
 }
 
 
@@ -413,6 +643,8 @@ cons_getc(void)
 	// (e.g., when called from the kernel monitor).
 	serial_intr();
 	kbd_intr();
+	// Likewise keep the output devices without interrupts going.
+	cons_drain(0);
 
 	// grab the next character from the input buffer.
 	if (cons.rpos != cons.wpos) {
@@ -424,13 +656,140 @@ cons_getc(void)
 	return 0;
 }
 
+static struct ConsSink serial_sink = {
+	.name = "serial", .drain = serial_drain, .wait = serial_wait
+};
+static struct ConsSink lpt_sink = {
+	.name = "lpt", .drain = lpt_drain
+};
+static struct ConsSink cga_sink = {
+	.name = "cga", .drain = cga_drain
+};
+
+static struct ConsSink *sinks[] = { &serial_sink, &lpt_sink, &cga_sink };
+#define NSINKS (sizeof(sinks)/sizeof(sinks[0]))
+
+// Write synchronously: each cons_putc waits until every sink has
+// taken the character (see cons_sync).
+static bool cons_synchronous;
+
+// Let every sink take what its device will accept now.  When
+// 'synchronous', wait for each sink that can wait to empty.
+static void
+cons_drain(bool synchronous)
+{
+	struct ConsSink *s;
+	int i;
+
+	for (i = 0; i < NSINKS; i++) {
+		s = sinks[i];
+		if (!s->enabled)
+			continue;
+		s->drain(s);
+		while (synchronous && s->wait && sink_pending(s) && s->wait())
+			s->drain(s);
+	}
+}
+
+// Make room in the output ring for 'n' more bytes.  A sink that is too
+// far behind is waited for, polling since the kernel runs with
+// interrupts off; a sink that cannot wait, or whose device times out,
+// loses its oldest bytes instead.
+static void
+cons_reserve(uint32_t n)
+{
+	struct ConsSink *s;
+	int i;
+
+	for (i = 0; i < NSINKS; i++) {
+		s = sinks[i];
+		if (!s->enabled || cons_out.wpos - s->rpos <= CONS_OUTSIZE - n)
+			continue;
+		s->drain(s);
+		if (cons_out.wpos - s->rpos <= CONS_OUTSIZE - n)
+			continue;
+		s->stalls++;
+		while (cons_out.wpos - s->rpos > CONS_OUTSIZE - n) {
+			if (s->wait && s->wait())
+				s->drain(s);
+			else {
+				s->rpos++;
+				s->drops++;
+			}
+		}
+	}
+}
+
 // output a character to the console
 static void
 cons_putc(int c)
 {
-	serial_putc(c);
-	lpt_putc(c);
-	cga_putc(c);
+	uint8_t ch = c;
+
+	cons_reserve(1);
+	if ((c & ~0xFF) && cga_sink.enabled) {
+		// The ring holds only bytes, so draw a character that
+		// carries its own attribute (cputchar(attr | ch)) on the
+		// display here, once the display has caught up.
+		cga_drain(&cga_sink);
+		cons_out.buf[cons_out.wpos++ % CONS_OUTSIZE] = ch;
+		cga_write(&ch, 1, c & ~0xFF);
+		cga_sink.rpos++;
+		cga_sink.bytes++;
+	} else
+		cons_out.buf[cons_out.wpos++ % CONS_OUTSIZE] = ch;
+	cons_drain(cons_synchronous);
+}
+
+// Largest piece of a cons_write queued at once, so that the sinks
+// can start on a long write before all of it is queued.
+#define CONS_WRITE_CHUNK	(CONS_OUTSIZE / 4)
+
+// Output 'len' bytes to the console.  Each piece is copied into the
+// output ring in one go, and then each sink takes it in bulk.
+void
+cons_write(const char *buf, size_t len)
+{
+	uint32_t n, off, m;
+
+	while (len > 0) {
+		n = MIN(len, CONS_WRITE_CHUNK);
+		cons_reserve(n);
+		off = cons_out.wpos % CONS_OUTSIZE;
+		m = MIN(n, CONS_OUTSIZE - off);
+		memcpy(cons_out.buf + off, buf, m);
+		memcpy(cons_out.buf, buf + m, n - m);
+		cons_out.wpos += n;
+		buf += n;
+		len -= n;
+		cons_drain(cons_synchronous);
+	}
+}
+
+// Flush queued output and write all further output synchronously.
+// Used by panic, which cannot count on interrupts draining the
+// console.
+void
+cons_sync(void)
+{
+	cons_synchronous = 1;
+	cons_drain(1);
+}
+
+// Print per-sink output counters.
+void
+cons_print_stats(void)
+{
+	struct ConsSink *s;
+	int i;
+
+	cprintf("sink     enabled      bytes     stalls      drops    queued\n");
+	for (i = 0; i < NSINKS; i++) {
+		s = sinks[i];
+		cprintf("%-8s %7s %10u %10u %10u %9u\n", s->name,
+			s->enabled ? "yes" : "no", s->bytes, s->stalls,
+			s->drops, s->enabled ? cons_out.wpos - s->rpos : 0);
+	}
 }
 
 // initialize the console devices
@@ -440,6 +799,7 @@ cons_init(void)
 	cga_init();
 	kbd_init();
 	serial_init();
+	lpt_init();
 
 	if (!serial_exists)
 		cprintf("Serial port does not exist!\n");
@@ -19,6 +19,9 @@
 
 void cons_init(void);
 int cons_getc(void);
+void cons_sync(void);
+void cons_write(const char *buf, size_t len);
+void cons_print_stats(void);
 
 void kbd_intr(void); // irq 1
 void serial_intr(void); // irq 4
@@ -6,18 +6,28 @@
 #include <inc/string.h>
 #include <inc/assert.h>
 #include <inc/elf.h>
+#include <inc/lz.h>
 #include <inc/types.h>
 
 #include <kern/env.h>
 #include <kern/pmap.h>
 #include <kern/trap.h>
 #include <kern/monitor.h>
+#include <kern/kclock.h>
+#include <kern/fpu.h>
+#include <kern/sched.h>
 
 
 struct Env *envs = NULL;		// All environments
 struct Env *curenv = NULL;		// The current env
 static struct Env *env_free_list;	// Free environment list
 					// (linked by Env->env_link)
+static uint32_t sched_ticks;		// env_run calls since boot
+uint32_t env_cr3_loads;			// env_run calls that reloaded CR3
+uint32_t env_cr3_skips;			// env_run calls that didn't need to
+struct Trapframe *curtf;		// curenv's live trap frame on the
+					// kernel stack, or NULL if env_tf
+					// is up to date
 
 #define ENVGENSHIFT	12		// >= LOGNENV
 
@@ -168,7 +178,7 @@ env_setup_vm(struct Env *e)
 	struct PageInfo *p = NULL;
 
 	// Allocate a page for the page directory
-	if (!(p = page_alloc(ALLOC_ZERO)))
+	if (!(p = page_alloc(0)))
 		return -E_NO_MEM;
 
 	// Now, set e->env_pgdir and initialize the page directory.
@@ -211,6 +221,40 @@ env_setup_vm(struct Env *e)
 	return 0;
 }
 
+//
+// Map the pages the kernel shares with every environment:
+// a zeroed page read-only at UVDSO, with the clock calibration filled
+// in, and a zeroed syscall ring read/write at USYSRING.  The kernel
+// writes the UVDSO page through e->env_vdso.
+//
+// Returns 0 on success, -E_NO_MEM if out of memory.
+//
+static int
+env_setup_kpages(struct Env *e)
+{
+	struct PageInfo *vd, *ring;
+
+	if (!(vd = page_alloc(ALLOC_ZERO)))
+		return -E_NO_MEM;
+	if (!(ring = page_alloc(ALLOC_ZERO))) {
+		page_free(vd);
+		return -E_NO_MEM;
+	}
+	// Both pages share a page table, so only the first insert can fail.
+	static_assert(PDX(UVDSO) == PDX(USYSRING));
+	if (page_insert(e->env_pgdir, vd, (void *) UVDSO, PTE_U) < 0) {
+		page_free(vd);
+		page_free(ring);
+		return -E_NO_MEM;
+	}
+	page_insert(e->env_pgdir, ring, (void *) USYSRING, PTE_U | PTE_W);
+
+	e->env_vdso = page2kva(vd);
+	e->env_vdso->vd_tsc_khz = tsc_khz;
+	e->env_vdso->vd_tsc_boot = tsc_boot;
+	return 0;
+}
+
 //
 // Allocates and initializes a new environment.
 // On success, the new environment is stored in *newenv_store.
@@ -232,18 +276,28 @@ env_alloc(struct Env **newenv_store, envid_t parent_id)
 	// Allocate and set up the page directory for this environment.
 	if ((r = env_setup_vm(e)) < 0)
 		return r;
+	if ((r = env_setup_kpages(e)) < 0) {
+		page_decref(pa2page(PADDR(e->env_pgdir)));
+		return r;
+	}
 
 	// Generate an env_id for this environment.
 	generation = (e->env_id + (1 << ENVGENSHIFT)) & ~(NENV - 1);
 	if (generation <= 0)	// Don't create a negative env_id.
 		generation = 1 << ENVGENSHIFT;
 	e->env_id = generation | (e - envs);
+	e->env_vdso->vd_envid = e->env_id;
 
 	// Set the basic status variables.
 	e->env_parent_id = parent_id;
 	e->env_type = ENV_TYPE_USER;
 	e->env_status = ENV_RUNNABLE;
 	e->env_runs = 0;
+	e->env_pgfault_upcall = 0;
+	e->env_ipc_recving = 0;
+	e->env_ipc_waitfor = 0;
+	e->env_notify_waiting = 0;
+	e->env_notify_pending = 0;
 
 	// Clear out all the saved register state,
 	// to prevent the register values
@@ -264,6 +318,9 @@ env_alloc(struct Env **newenv_store, envid_t parent_id)
 	e->env_tf.tf_ss = GD_UD | 3;
 	e->env_tf.tf_esp = USTACKTOP;
 	e->env_tf.tf_cs = GD_UT | 3;
+	// Enable interrupts while in user mode, so that the console's
+	// transmit interrupt can be delivered.
+	e->env_tf.tf_eflags = FL_IF;
 	// You will set e->env_tf.tf_eip later.
 
 	// commit the allocation
@@ -303,6 +360,77 @@ region_alloc(struct Env *e, void *va, size_t len)
 	}
 }
 
+//
+// Map fresh pages at [va, va + memsz) in e and fill them through
+// their kernel mappings: the first filesz bytes from 'src', the rest
+// (and any part of the first and last page outside the segment) with
+// zeros.  Pages wholly inside the file data or wholly past it go
+// through page_copy/page_zero; only the partial pages at the edges
+// are done bytewise.
+//
+static void
+load_segment(struct Env *e, const uint8_t *src, uintptr_t va,
+	     size_t filesz, size_t memsz)
+{
+	struct PageInfo *pp;
+	uint8_t *kva;
+	uintptr_t pg, lo, hi;
+
+	for (pg = ROUNDDOWN(va, PGSIZE); pg < va + memsz; pg += PGSIZE) {
+		if (!(pp = page_alloc(0)))
+			panic("load_segment: out of memory");
+		if (page_insert(e->env_pgdir, pp, (void *) pg, PTE_U | PTE_W | PTE_P) < 0)
+			panic("load_segment: page table couldn't be allocated");
+		kva = page2kva(pp);
+
+		// File bytes that land in this page: [lo, hi)
+		lo = MAX(pg, va);
+		hi = MIN(pg + PGSIZE, va + filesz);
+		if (lo == pg && hi == pg + PGSIZE)
+			page_copy(kva, src + (pg - va));
+		else if (lo >= hi)
+			page_zero(kva);
+		else {
+			memset(kva, 0, lo - pg);
+			memmove(kva + (lo - pg), src + (lo - va), hi - lo);
+			memset(kva + (hi - pg), 0, pg + PGSIZE - hi);
+		}
+	}
+}
+
+//
+// Like load_segment, but the file bytes come compressed, as the LZ4
+// block of clen bytes at 'src', and are decoded straight into e's
+// pages.  Only pages not wholly covered by file data are zeroed first.
+// The decoder runs with e's page directory loaded so that it sees the
+// segment as one buffer and can follow matches across pages.
+//
+static void
+load_lzsegment(struct Env *e, const uint8_t *src, size_t clen,
+	       uintptr_t va, size_t filesz, size_t memsz)
+{
+	struct PageInfo *pp;
+	uintptr_t pg;
+	uint32_t cr3;
+	int r;
+
+	for (pg = ROUNDDOWN(va, PGSIZE); pg < va + memsz; pg += PGSIZE) {
+		if (!(pp = page_alloc(0)))
+			panic("load_lzsegment: out of memory");
+		if (page_insert(e->env_pgdir, pp, (void *) pg, PTE_U | PTE_W | PTE_P) < 0)
+			panic("load_lzsegment: page table couldn't be allocated");
+		if (pg < va || pg + PGSIZE > va + filesz)
+			page_zero(page2kva(pp));
+	}
+
+	cr3 = rcr3();
+	lcr3(PADDR(e->env_pgdir));
+	r = lz_decode((void *) va, filesz, src, clen);
+	lcr3(cr3);
+	if (r != filesz)
+		panic("load_lzsegment: bad compressed segment at %08x", va);
+}
+
 //
 // Set up the initial program binary, stack, and processor flags
 // for a user process.
@@ -322,6 +450,9 @@ region_alloc(struct Env *e, void *va, size_t len)
 //
 // Finally, this function maps one page for the program's initial stack.
 //
+// The binaries linked into the kernel are packed by boot/lzpack
+// (see inc/lz.h); a plain ELF binary is accepted too.
+//
 // load_icode panics if it encounters problems.
 //  - How might load_icode fail?  What might be wrong with the given input?
 //
@@ -360,6 +491,20 @@ load_icode(struct Env *e, uint8_t *binary)
 
   	struct Proghdr *ph, *eph;
 	struct Elf *elfhdr = (struct Elf *)binary;
+	struct LzImage *img = (struct LzImage *)binary;
+	struct LzSeg *ls;
+
+	// a packed image carries only its segments and entry point
+	if (img->lz_magic == LZ_MAGIC) {
+		for (ls = img->lz_seg; ls < img->lz_seg + img->lz_nseg; ls++) {
+			if (ls->ls_filesz > ls->ls_memsz)
+				panic("load_icode: size in file > size in memory");
+			load_lzsegment(e, binary + ls->ls_off, ls->ls_clen,
+				       ls->ls_va, ls->ls_filesz, ls->ls_memsz);
+		}
+		e->env_tf.tf_eip = img->lz_entry;
+		goto stack;
+	}
 
 	// is this a valid ELF?
 	if (elfhdr->e_magic != ELF_MAGIC)
@@ -369,23 +514,19 @@ load_icode(struct Env *e, uint8_t *binary)
 	ph = (struct Proghdr *) (binary + elfhdr->e_phoff);
 	eph = ph + elfhdr->e_phnum;
 
-	// e's page directory should be inforced
-	lcr3(PADDR(e->env_pgdir));
-
 	for (; ph < eph; ph++){
 		if (ph->p_type != ELF_PROG_LOAD)
 				continue;
 		if (ph->p_filesz > ph->p_memsz)
             panic("load_icode: size in file > size in memory");
 
-		region_alloc(e, (void *)(ph->p_va), ph->p_memsz);
-		memmove((void *)(ph->p_va), (uint8_t *)binary + ph->p_offset, ph->p_filesz);
-		memset((void *)(ph->p_va+ph->p_filesz), 0, ph->p_memsz-ph->p_filesz);
+		load_segment(e, binary + ph->p_offset, ph->p_va,
+			     ph->p_filesz, ph->p_memsz);
 	}
 
-	lcr3(PADDR(kern_pgdir));
 	e->env_tf.tf_eip = elfhdr->e_entry;
 	
+stack:
 	// Now map one page for the program's initial stack
 	// at virtual address USTACKTOP - PGSIZE.
 
@@ -428,9 +569,14 @@ env_free(struct Env *e)
 
 	// If freeing the current environment, switch to kern_pgdir
 	// before freeing the page directory, just in case the page
-	// gets reused.
-	if (e == curenv)
+	// gets reused.  Its live trap frame is no longer wanted.
+	if (e == curenv) {
 		lcr3(PADDR(kern_pgdir));
+		curtf = NULL;
+	}
+
+	// Its FPU registers, if loaded, need never be saved.
+	fpu_release(e);
 
 	// Note the environment's demise.
 	cprintf("[%08x] free env %08x\n", curenv ? curenv->env_id : 0, e->env_id);
@@ -461,6 +607,7 @@ env_free(struct Env *e)
 	// free the page directory
 	pa = PADDR(e->env_pgdir);
 	e->env_pgdir = 0;
+	e->env_vdso = 0;
 	page_decref(pa2page(pa));
 
 	// return the environment to the free list
@@ -471,15 +618,18 @@ env_free(struct Env *e)
 
 //
 // Frees environment e.
+// If e was the current env, then runs a new environment (and does not
+// return to the caller).
 //
 void
 env_destroy(struct Env *e)
 {
 	env_free(e);
 
-	cprintf("Destroyed the only environment - nothing more to do!\n");
-	while (1)
-		monitor(NULL);
+	if (curenv == e) {
+		curenv = NULL;
+		sched_yield();
+	}
 }
 
 
@@ -502,6 +652,20 @@ env_pop_tf(struct Trapframe *tf)
 	panic("iret failed");  /* mostly to placate the compiler */
 }
 
+//
+// Copy curenv's live trap frame, if any, into curenv->env_tf.
+// Must be called before curenv stops running or its saved
+// registers are examined from env_tf.
+//
+void
+env_save_tf(void)
+{
+	if (curtf) {
+		curenv->env_tf = *curtf;
+		curtf = NULL;
+	}
+}
+
 //
 // Context switch from curenv to env e.
 // Note: if this is the first call to env_run, curenv is NULL.
@@ -530,19 +694,30 @@ env_run(struct Env *e)
 
 	// LAB 3: Your code here.
 
-	if (curenv != NULL){
-		if (curenv->env_status != ENV_RUNNING){
-			panic("env_run: curenv is not currently running");
-		} else {
+	if (e != curenv) {
+		// The trap frame on the stack is about to be abandoned.
+		env_save_tf();
+		// curenv may also be blocked (ENV_NOT_RUNNABLE).
+		if (curenv != NULL && curenv->env_status == ENV_RUNNING)
 			curenv->env_status = ENV_RUNNABLE;
-		}
+		// switch envs
+		curenv = e;
+		fpu_switch(e);
 	}
-	// switch envs
-	curenv = e;
 	curenv->env_status = ENV_RUNNING;
 	curenv->env_runs++;
-	lcr3(PADDR(curenv->env_pgdir));
-
+	curenv->env_vdso->vd_ticks = ++sched_ticks;
+
+	// Reloading CR3 flushes the TLB, so skip it if e's page
+	// directory is already loaded (same env, or we never left it).
+	if (rcr3() != PADDR(curenv->env_pgdir)) {
+		lcr3(PADDR(curenv->env_pgdir));
+		env_cr3_loads++;
+	} else
+		env_cr3_skips++;
+
+	// Resuming the env that trapped: its frame is still live.
+	if (curtf)
+		env_pop_tf(curtf);
 	env_pop_tf(&(curenv->env_tf));
 }
-
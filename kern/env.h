@@ -7,6 +7,9 @@
 
 extern struct Env *envs;		// All environments
 extern struct Env *curenv;		// Current environment
+extern struct Trapframe *curtf;		// curenv's live trap frame, or NULL
+extern uint32_t env_cr3_loads;
+extern uint32_t env_cr3_skips;
 extern struct Segdesc gdt[];
 
 void	env_init(void);
@@ -15,6 +18,7 @@ int	env_alloc(struct Env **e, envid_t parent_id);
 void	env_free(struct Env *e);
 void	env_create(uint8_t *binary, enum EnvType type);
 void	env_destroy(struct Env *e);	// Does not return if e == curenv
+void	env_save_tf(void);
 
 int	envid2env(envid_t envid, struct Env **env_store, bool checkperm);
 // The following two functions do not return
@@ -25,10 +29,11 @@ void	env_pop_tf(struct Trapframe *tf) __attribute__((noreturn));
 // ENV_CREATE because of the C pre-processor's argument prescan rule.
 #define ENV_PASTE3(x, y, z) x ## y ## z
 
+// The user binaries are linked in packed by boot/lzpack, as obj/user/x.lz.
 #define ENV_CREATE(x, type)						\
 	do {								\
-		extern uint8_t ENV_PASTE3(_binary_obj_, x, _start)[];	\
-		env_create(ENV_PASTE3(_binary_obj_, x, _start),		\
+		extern uint8_t ENV_PASTE3(_binary_obj_, x, _lz_start)[];	\
+		env_create(ENV_PASTE3(_binary_obj_, x, _lz_start),	\
 			   type);					\
 	} while (0)
 
@@ -0,0 +1,103 @@
+/* See COPYRIGHT for copyright information. */
+
+// Lazy FPU/SSE context switching.
+//
+// The FPU registers belong to at most one env at a time, 'fpu_owner'.
+// env_run sets CR0_TS whenever it resumes any other env, so that env's
+// first FPU or SSE instruction raises T_DEVICE.  fpu_trap then saves
+// the owner's registers, loads the faulting env's registers (or a
+// clean state on first use), and hands it the FPU.  Envs that never
+// touch the FPU never pay for a save or restore.
+//
+// An env's saved registers live in a kernel page of their own,
+// allocated on its first T_DEVICE and indexed by ENVX, rather than in
+// struct Env: the envs array is mapped read-only at UENVS, and one
+// env must not be able to read another's registers.
+
+#include <inc/x86.h>
+#include <inc/mmu.h>
+#include <inc/assert.h>
+
+#include <kern/env.h>
+#include <kern/pmap.h>
+#include <kern/fpu.h>
+
+#define CPUID_FXSR	(1 << 24)	// CPUID.1:EDX FXSAVE/FXRSTOR
+#define MXCSR_DEFAULT	0x1f80		// all SIMD exceptions masked
+
+// FPU/MMX/SSE register state, in FXSAVE format.
+struct Fpregs {
+	uint8_t fp_area[512];
+} __attribute__((aligned(16)));
+
+static struct Env *fpu_owner;		// env whose state is in the FPU
+static struct Fpregs *fpu_regs[NENV];	// saved registers, or NULL
+
+// Enable FXSAVE/FXRSTOR and SSE, and trap the first FPU use.
+void
+fpu_init(void)
+{
+	uint32_t edx;
+
+	cpuid(1, NULL, NULL, NULL, &edx);
+	if (!(edx & CPUID_FXSR))
+		panic("fpu_init: CPU lacks FXSAVE/FXRSTOR");
+	lcr4(rcr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+	lcr0(rcr0() | CR0_TS);
+}
+
+// Called by env_run when switching to e: the FPU may only be used
+// without a trap if it already holds e's registers.
+void
+fpu_switch(struct Env *e)
+{
+	if (e == fpu_owner)
+		clts();
+	else
+		lcr0(rcr0() | CR0_TS);
+}
+
+// Handle T_DEVICE from curenv: give it the FPU.
+void
+fpu_trap(void)
+{
+	uint32_t mxcsr = MXCSR_DEFAULT;
+	struct Fpregs **regs = &fpu_regs[ENVX(curenv->env_id)];
+	struct PageInfo *pp;
+	bool first = 0;
+
+	clts();
+	if (fpu_owner == curenv)
+		return;
+	if (!*regs) {
+		if (!(pp = page_alloc(0))) {
+			cprintf("[%08x] no memory for FPU state\n",
+				curenv->env_id);
+			env_destroy(curenv);
+		}
+		*regs = page2kva(pp);
+		first = 1;
+	}
+	if (fpu_owner)
+		fxsave(fpu_regs[ENVX(fpu_owner->env_id)]);
+	if (first)
+		asm volatile("fninit; ldmxcsr %0" : : "m" (mxcsr));
+	else
+		fxrstor(*regs);
+	fpu_owner = curenv;
+}
+
+// Called when e is freed: its registers need never be saved, and its
+// page goes back to the free list.
+void
+fpu_release(struct Env *e)
+{
+	struct Fpregs **regs = &fpu_regs[ENVX(e->env_id)];
+
+	if (fpu_owner == e)
+		fpu_owner = NULL;
+	if (*regs) {
+		page_free(pa2page(PADDR(*regs)));
+		*regs = NULL;
+	}
+}
@@ -3,6 +3,8 @@
 #include <inc/stdio.h>
 #include <inc/string.h>
 #include <inc/assert.h>
+#include <inc/x86.h>
+#include <inc/memlayout.h>
 
 #include <kern/monitor.h>
 #include <kern/console.h>
@@ -10,12 +12,15 @@
 #include <kern/kclock.h>
 #include <kern/env.h>
 #include <kern/trap.h>
+#include <kern/fpu.h>
+#include <kern/picirq.h>
 
 
 void
 i386_init(void)
 {
 	extern char edata[], end[];
+	uint64_t boot_tsc, init_tsc = read_tsc();
 
 	// Before doing anything else, complete the ELF loading process.
 	// Clear the uninitialized global data (BSS) section of our program.
@@ -28,12 +33,28 @@ i386_init(void)
 
 	cprintf("6828 decimal is %o octal!\n", 6828);
 
+	// Calibrate the TSC for the per-environment clock.
+	tsc_init();
+
+	// Report how long the boot loader took to load us, if it left
+	// its starting TSC value behind.
+	boot_tsc = *(uint64_t *) (KERNBASE + BOOT_TSC);
+	if (tsc_khz && boot_tsc && boot_tsc < init_tsc)
+		cprintf("boot: %llu us from bootmain to i386_init\n",
+			(init_tsc - boot_tsc) * 1000 / tsc_khz);
+
 	// Lab 2 memory management initialization functions
 	mem_init();
 
 	// Lab 3 user environment initialization functions
 	env_init();
 	trap_init();
+	fpu_init();
+
+	// Interrupt controller initialization.  Only the serial port's
+	// IRQ is unmasked (see serial_init), and interrupts are only
+	// enabled while running user environments.
+	pic_init();
 
 #if defined(TEST)
 	// Don't touch -- used by grading script!
@@ -70,6 +91,9 @@ _panic(const char *file, int line, const char *fmt,...)
 	// Be extra sure that the machine is in as reasonable state
 	__asm __volatile("cli; cld");
 
+	// Interrupts may never come again: write the console synchronously.
+	cons_sync();
+
 	va_start(ap, fmt);
 	cprintf("kernel panic at %s:%d: ", file, line);
 	vcprintf(fmt, ap);
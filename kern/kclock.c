@@ -20,3 +20,34 @@ mc146818_write(unsigned reg, unsigned datum)
 	outb(IO_RTC, reg);
 	outb(IO_RTC+1, datum);
 }
+
+
+/* Support for calibrating the time-stamp counter against the PIT. */
+
+uint32_t tsc_khz;		// TSC ticks per millisecond
+uint64_t tsc_boot;		// TSC value when the clock was calibrated
+
+// Count TSC ticks while PIT channel 2 counts down TSC_CAL_MS
+// milliseconds in one-shot mode.  Channel 2's output is visible in
+// bit 5 of port 0x61 and goes high at terminal count.
+void
+tsc_init(void)
+{
+	uint64_t t0, t1;
+	uint16_t latch = PIT_HZ * TSC_CAL_MS / 1000;
+
+	// Gate channel 2 on, speaker off
+	outb(IO_PIT_GATE, (inb(IO_PIT_GATE) & ~0x02) | 0x01);
+	// Channel 2, lobyte/hibyte access, mode 0 (interrupt on count)
+	outb(IO_PIT_MODE, 0xb0);
+	outb(IO_PIT_CH2, latch & 0xff);
+	outb(IO_PIT_CH2, latch >> 8);
+
+	t0 = read_tsc();
+	while (!(inb(IO_PIT_GATE) & 0x20))
+		/* do nothing */;
+	t1 = read_tsc();
+
+	tsc_khz = (t1 - t0) / TSC_CAL_MS;
+	tsc_boot = t1;
+}
@@ -6,6 +6,8 @@
 # error "This is a JOS kernel header; user programs should not #include it"
 #endif
 
+#include <inc/types.h>
+
 #define	IO_RTC		0x070		/* RTC port */
 
 #define	MC_NVRAM_START	0xe	/* start of NVRAM: offset 14 */
@@ -26,7 +28,18 @@
 /* NVRAM byte 36: current century.  (please increment in Dec99!) */
 #define NVRAM_CENTURY	(MC_NVRAM_START + 36)	/* RTC offset 0x32 */
 
+#define	IO_PIT_CH2	0x042		/* 8253 PIT channel 2 data */
+#define	IO_PIT_MODE	0x043		/* 8253 PIT mode/command */
+#define	IO_PIT_GATE	0x061		/* PIT channel 2 gate and output */
+#define	PIT_HZ		1193182		/* PIT input clock */
+#define	TSC_CAL_MS	10		/* TSC calibration interval */
+
 unsigned mc146818_read(unsigned reg);
 void mc146818_write(unsigned reg, unsigned datum);
 
+extern uint32_t tsc_khz;
+extern uint64_t tsc_boot;
+
+void tsc_init(void);
+
 #endif	// !JOS_KERN_KCLOCK_H
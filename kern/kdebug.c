@@ -19,6 +19,27 @@ struct UserStabData {
 	const char *stabstr_end;
 };
 
+// Index of the kernel's address ranges, built from its stabs on the
+// first lookup so that finding the function containing an address
+// takes one binary search instead of three stab_binsearch passes.
+// There is one entry per function (N_FUN) and one for the start of
+// each source file (N_SO), which covers any code before the file's
+// first function, such as assembly.  Entries are sorted by address
+// and cover [fi_addr, fi_eaddr); the range of stabs describing an
+// entry, including its line numbers, is [fi_stab, fi_end).
+struct FnIndex {
+	uintptr_t fi_addr;	// start address
+	uintptr_t fi_eaddr;	// end address
+	uint32_t fi_file;	// stab index of the N_SO of its source file
+	uint32_t fi_stab;	// stab index of the N_FUN, or the N_SO
+	uint32_t fi_end;	// stab index just past its stabs
+};
+
+#define FN_INDEX_MAX	2048
+
+static struct FnIndex fn_index[FN_INDEX_MAX];
+static int fn_nindex = -1;	// entries, or -1 if not built yet
+
 
 // stab_binsearch(stabs, region_left, region_right, type, addr)
 //
@@ -103,6 +124,89 @@ stab_binsearch(const struct Stab *stabs, int *region_left, int *region_right,
 }
 
 
+// Build fn_index from the kernel's stabs.  Stab 0 is the table's
+// header.  An N_FUN or N_SO with an empty name marks the end of a
+// function or file, and holds the function's size or the file's end
+// address; the stabs and code after it, up to the next entry, are
+// left out of the preceding entry's ranges.  Entries without an end
+// marker run to the start of the next entry, or to etext.
+static void
+fn_index_init(void)
+{
+	extern char etext[];
+	const struct Stab *stabs = __STAB_BEGIN__;
+	uint32_t i, n = __STAB_END__ - __STAB_BEGIN__, file = 0;
+	struct FnIndex fi, *last;
+	int j, open = 0;
+
+	fn_nindex = 0;
+	for (i = 1; i < n; i++) {
+		if (stabs[i].n_type != N_SO && stabs[i].n_type != N_FUN)
+			continue;
+		if (stabs[i].n_strx >= __STABSTR_END__ - __STABSTR_BEGIN__)
+			continue;
+		// Whatever comes next ends the open entry, if any
+		last = open ? &fn_index[fn_nindex - 1] : NULL;
+		if (last)
+			last->fi_end = i;
+		open = __STABSTR_BEGIN__[stabs[i].n_strx] != '\0';
+		if (!open) {
+			if (last && stabs[i].n_type == N_FUN)
+				last->fi_eaddr = last->fi_addr + stabs[i].n_value;
+			else if (last)
+				last->fi_eaddr = stabs[i].n_value;
+			continue;
+		}
+		if (fn_nindex == FN_INDEX_MAX) {
+			// Too many: fall back to searching the stabs
+			fn_nindex = 0;
+			return;
+		}
+		if (stabs[i].n_type == N_SO)
+			file = i;
+		fn_index[fn_nindex].fi_addr = stabs[i].n_value;
+		fn_index[fn_nindex].fi_eaddr = 0;
+		fn_index[fn_nindex].fi_file = file;
+		fn_index[fn_nindex].fi_stab = i;
+		fn_index[fn_nindex].fi_end = n;
+		fn_nindex++;
+	}
+
+	// The stabs are almost always in address order already.
+	// Insertion sort is stable, which keeps a function after the
+	// N_SO of its file when both start at the same address.
+	for (i = 1; i < fn_nindex; i++) {
+		fi = fn_index[i];
+		for (j = i - 1; j >= 0 && fn_index[j].fi_addr > fi.fi_addr; j--)
+			fn_index[j + 1] = fn_index[j];
+		fn_index[j + 1] = fi;
+	}
+
+	for (j = 0; j < fn_nindex; j++)
+		if (!fn_index[j].fi_eaddr)
+			fn_index[j].fi_eaddr = j + 1 < fn_nindex
+				? fn_index[j + 1].fi_addr : (uintptr_t) etext;
+}
+
+// Return the index entry covering 'addr', or NULL if there is none.
+static const struct FnIndex *
+fn_lookup(uintptr_t addr)
+{
+	int l = 0, r = fn_nindex - 1, m;
+
+	while (l <= r) {
+		m = (l + r) / 2;
+		if (fn_index[m].fi_addr <= addr)
+			l = m + 1;
+		else
+			r = m - 1;
+	}
+	if (r < 0 || addr >= fn_index[r].fi_eaddr)
+		return NULL;
+	return &fn_index[r];
+}
+
+
 // debuginfo_eip(addr, info)
 //
 //	Fill in the 'info' structure with information about the specified
@@ -115,6 +219,7 @@ debuginfo_eip(uintptr_t addr, struct Eipdebuginfo *info)
 {
 	const struct Stab *stabs, *stab_end;
 	const char *stabstr, *stabstr_end;
+	const struct FnIndex *fi;
 	int lfile, rfile, lfun, rfun, lline, rline;
 
 	// Initialize *info
@@ -167,18 +272,36 @@ debuginfo_eip(uintptr_t addr, struct Eipdebuginfo *info)
 	// Then, we look in that source file for the function.  Then we look
 	// for the line number.
 
-	// Search the entire set of stabs for the source file (type N_SO).
-	lfile = 0;
-	rfile = (stab_end - stabs) - 1;
-	stab_binsearch(stabs, &lfile, &rfile, N_SO, addr);
-	if (lfile == 0)
-		return -1;
+	// For the kernel, fn_index does both of the first two steps.
+	if (addr >= ULIM && fn_nindex < 0)
+		fn_index_init();
+	if (addr >= ULIM && fn_nindex > 0) {
+		if (!(fi = fn_lookup(addr)))
+			return -1;
+		lfile = fi->fi_file;
+		rfile = fi->fi_end - 1;
+		if (stabs[fi->fi_stab].n_type == N_FUN) {
+			lfun = fi->fi_stab;
+			rfun = fi->fi_end - 1;
+		} else {
+			lfun = 1;
+			rfun = 0;
+		}
+	} else {
+		// Search the entire set of stabs for the source file
+		// (type N_SO).
+		lfile = 0;
+		rfile = (stab_end - stabs) - 1;
+		stab_binsearch(stabs, &lfile, &rfile, N_SO, addr);
+		if (lfile == 0)
+			return -1;
 
-	// Search within that file's stabs for the function definition
-	// (N_FUN).
-	lfun = lfile;
-	rfun = rfile;
-	stab_binsearch(stabs, &lfun, &rfun, N_FUN, addr);
+		// Search within that file's stabs for the function
+		// definition (N_FUN).
+		lfun = lfile;
+		rfun = rfile;
+		stab_binsearch(stabs, &lfun, &rfun, N_FUN, addr);
+	}
 
 	if (lfun <= rfun) {
 		// stabs[lfun] points to the function name
@@ -201,16 +324,12 @@ debuginfo_eip(uintptr_t addr, struct Eipdebuginfo *info)
 	info->eip_fn_namelen = strfind(info->eip_fn_name, ':') - info->eip_fn_name;
 
 
-	// Search within [lline, rline] for the line number stab.
-	// If found, set info->eip_line to the right line number.
-	// If not found, return -1.
-	//
-	// Hint:
-	//	There's a particular stabs type used for line numbers.
-	//	Look at the STABS documentation and <inc/stab.h> to find
-	//	which one.
-	// Your code here.
-
+	// Search within [lline, rline] for the line number stab (N_SLINE).
+	// If found, set info->eip_line to its line number; if not, leave
+	// it 0, as code without line stabs is still worth reporting.
+	stab_binsearch(stabs, &lline, &rline, N_SLINE, addr);
+	if (lline <= rline)
+		info->eip_line = stabs[lline].n_desc;
 
 	// Search backwards from the line number for the relevant filename
 	// stab.
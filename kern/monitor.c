@@ -13,6 +13,8 @@
 #include <kern/pmap.h>
 #include <kern/trap.h>
 #include <kern/env.h>
+#include <kern/syscall.h>
+#include <kern/trace.h>
 
 #define CMDBUF_SIZE	80	// enough for one VGA text line
 #define	BOOTSTACKTOP 0xf0100000
@@ -33,6 +35,11 @@ static struct Command commands[] = {
 	{ "content", "Dump the contents of a range of memory given either a virtual or physical address", mon_content },
 	{ "c", "continue", mon_continue },
 	{ "si", "step", mon_step },
+	{ "sysprof", "Show (or 'reset') per-syscall call counts and cycles", mon_sysprof },
+	{ "trace", "Dump the trap trace: trace [trap N | env ID | clear]", mon_trace },
+	{ "envstat", "Display environment switch counters", mon_envstat },
+	{ "consstat", "Display per-device console output counters", mon_consstat },
+	{ "printbench", "Time kernel console output: printbench [lines]", mon_printbench },
 };
 #define NCOMMANDS (sizeof(commands)/sizeof(commands[0]))
 
@@ -316,8 +323,8 @@ mon_continue(int argc, char **argv, struct Trapframe *tf)
 		return 0;
 	}
 	tf->tf_eflags &= ~FL_TF;
-	env_run(curenv);
-	return 0;
+	// Leave the monitor; trap() resumes the env from tf.
+	return -1;
 }
 
 int
@@ -332,7 +339,94 @@ mon_step(int argc, char **argv, struct Trapframe *tf)
 		return 0;
 	}
 	tf->tf_eflags |= FL_TF;
-	env_run(curenv);
+	return -1;
+}
+
+int
+mon_sysprof(int argc, char **argv, struct Trapframe *tf)
+{
+	if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+		syscall_reset_stats();
+		return 0;
+	}
+	syscall_print_stats();
+	return 0;
+}
+
+int
+mon_trace(int argc, char **argv, struct Trapframe *tf)
+{
+	if (argc == 1) {
+		trace_dump(-1, 0);
+		return 0;
+	}
+	if (strcmp(argv[1], "clear") == 0) {
+		trace_clear();
+		return 0;
+	}
+	if (argc == 3 && strcmp(argv[1], "trap") == 0) {
+		trace_dump(strtol(argv[2], NULL, 0), 0);
+		return 0;
+	}
+	if (argc == 3 && strcmp(argv[1], "env") == 0) {
+		trace_dump(-1, strtol(argv[2], NULL, 16));
+		return 0;
+	}
+	cprintf("usage: trace [trap N | env ID | clear]\n");
+	return 0;
+}
+
+int
+mon_envstat(int argc, char **argv, struct Trapframe *tf)
+{
+	cprintf("env_run: %u cr3 reloads, %u skipped\n",
+		env_cr3_loads, env_cr3_skips);
+	return 0;
+}
+
+int
+mon_consstat(int argc, char **argv, struct Trapframe *tf)
+{
+	cons_print_stats();
+	return 0;
+}
+
+// Print the same lines a character at a time through cputchar (how
+// cprintf used to reach the console) and through cprintf, and report
+// the cycles per line for each, along with the cost of formatting
+// the line alone with snprintf.
+int
+mon_printbench(int argc, char **argv, struct Trapframe *tf)
+{
+	static const char line[] =
+		"printbench: the quick brown fox jumps over the lazy dog 0123456789\n";
+	int i, n = 100;
+	const char *p;
+	uint64_t t0, t1, t2, t3;
+	char buf[sizeof(line)];
+
+	if (argc > 1 && (n = strtol(argv[1], NULL, 0)) <= 0)
+		n = 100;
+
+	t0 = read_tsc();
+	for (i = 0; i < n; i++)
+		for (p = line; *p; p++)
+			cputchar(*p);
+	t1 = read_tsc();
+	for (i = 0; i < n; i++)
+		cprintf("printbench: the quick brown %s jumps over the lazy %s 0%d\n",
+			"fox", "dog", 123456789);
+	t2 = read_tsc();
+	for (i = 0; i < n; i++)
+		snprintf(buf, sizeof(buf),
+			 "printbench: the quick brown %s jumps over the lazy %s 0%d\n",
+			 "fox", "dog", 123456789);
+	t3 = read_tsc();
+
+	cprintf("printbench: %d lines of %d bytes\n", n, sizeof(line) - 1);
+	cprintf("  cputchar: %llu cycles/line\n", (t1 - t0) / n);
+	cprintf("  cprintf:  %llu cycles/line\n", (t2 - t1) / n);
+	cprintf("  snprintf: %llu cycles/line\n", (t3 - t2) / n);
 	return 0;
 }
 
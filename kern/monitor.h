@@ -20,5 +20,10 @@ int mon_modifyperm(int argc, char **argv, struct Trapframe *tf);
 int mon_content(int argc, char **argv, struct Trapframe *tf);
 int mon_continue(int argc, char **argv, struct Trapframe *tf);
 int mon_step(int argc, char **argv, struct Trapframe *tf);
+int mon_sysprof(int argc, char **argv, struct Trapframe *tf);
+int mon_trace(int argc, char **argv, struct Trapframe *tf);
+int mon_envstat(int argc, char **argv, struct Trapframe *tf);
+int mon_consstat(int argc, char **argv, struct Trapframe *tf);
+int mon_printbench(int argc, char **argv, struct Trapframe *tf);
 
 #endif	// !JOS_KERN_MONITOR_H
@@ -11,6 +11,10 @@
 #include <kern/kclock.h>
 #include <kern/env.h>
 
+#define CPUID_SSE2	(1 << 26)	// CPUID.1:EDX, which includes movnti
+
+static int page_nt;		// page_zero/page_copy use movnti
+
 // These variables are set by i386_detect_memory()
 size_t npages;			// Amount of physical memory (in pages)
 static size_t npages_basemem;	// Amount of base memory (in pages)
@@ -129,12 +133,16 @@ boot_alloc(uint32_t n)
 void
 mem_init(void)
 {
-	uint32_t cr0;
+	uint32_t cr0, edx;
 	size_t n;
 
 	// Find out how much memory the machine has (npages & npages_basemem).
 	i386_detect_memory();
 
+	// Can page_zero and page_copy stream around the cache?
+	cpuid(1, NULL, NULL, NULL, &edx);
+	page_nt = !!(edx & CPUID_SSE2);
+
 	//////////////////////////////////////////////////////////////////////
 	// create initial page directory.
 	kern_pgdir = (pde_t *) boot_alloc(PGSIZE);
@@ -333,7 +341,7 @@ page_alloc(int alloc_flags)
 	new_page->pp_link = NULL;
 
 	if (alloc_flags & ALLOC_ZERO){
-		memset(page2kva(new_page), '\0', PGSIZE);
+		page_zero(page2kva(new_page));
 	}
 
 	return new_page;
@@ -358,6 +366,76 @@ page_free(struct PageInfo *pp)
 	page_free_list = pp;
 }
 
+//
+// Fill the page at 'kva' with zeros.
+//
+// A page being zeroed or copied is usually not read again for a while,
+// so when the CPU has it this uses movnti, whose stores bypass the
+// cache instead of evicting 4KB of the running env's working set.
+// movnti needs only integer registers, so it is safe in the kernel,
+// which must not touch the FPU/SSE state.  The stores are weakly
+// ordered; the sfence completes them before the page is used.
+//
+void
+page_zero(void *kva)
+{
+	uint32_t *p = kva, *end = p + PGSIZE / 4;
+	size_t n = PGSIZE / 4;
+
+	assert(PGOFF(kva) == 0);
+	if (!page_nt) {
+		asm volatile("cld; rep stosl"
+			     : "+D" (p), "+c" (n) : "a" (0)
+			     : "cc", "memory");
+		return;
+	}
+	asm volatile("1:\tmovnti %2, (%0)\n\t"
+		     "movnti %2, 4(%0)\n\t"
+		     "movnti %2, 8(%0)\n\t"
+		     "movnti %2, 12(%0)\n\t"
+		     "addl $16, %0\n\t"
+		     "cmpl %1, %0\n\t"
+		     "jne 1b\n\t"
+		     "sfence"
+		     : "+r" (p) : "r" (end), "r" (0) : "cc", "memory");
+}
+
+//
+// Copy the page at 'src' to the page at 'dst'.  Only 'dst' need be
+// page-aligned.  Uses streaming stores like page_zero.
+//
+void
+page_copy(void *dst, const void *src)
+{
+	uint32_t *d = dst, *end = d + PGSIZE / 4;
+	const uint32_t *s = src;
+	uint32_t x, y;
+	size_t n = PGSIZE / 4;
+
+	assert(PGOFF(dst) == 0);
+	if (!page_nt) {
+		asm volatile("cld; rep movsl"
+			     : "+D" (d), "+S" (s), "+c" (n)
+			     : : "cc", "memory");
+		return;
+	}
+	asm volatile("1:\tmovl (%1), %2\n\t"
+		     "movl 4(%1), %3\n\t"
+		     "movnti %2, (%0)\n\t"
+		     "movnti %3, 4(%0)\n\t"
+		     "movl 8(%1), %2\n\t"
+		     "movl 12(%1), %3\n\t"
+		     "movnti %2, 8(%0)\n\t"
+		     "movnti %3, 12(%0)\n\t"
+		     "addl $16, %1\n\t"
+		     "addl $16, %0\n\t"
+		     "cmpl %4, %0\n\t"
+		     "jne 1b\n\t"
+		     "sfence"
+		     : "+r" (d), "+r" (s), "=&r" (x), "=&r" (y)
+		     : "r" (end) : "cc", "memory");
+}
+
 //
 // Decrement the reference count on a page,
 // freeing it if there are no more refs.
@@ -1,25 +1,54 @@
 // Simple implementation of cprintf console output for the kernel,
-// based on printfmt() and the kernel console's cputchar().
+// based on printfmt() and the kernel console's cons_write().
 
 #include <inc/types.h>
 #include <inc/stdio.h>
 #include <inc/stdarg.h>
+#include <inc/string.h>
 
+#include <kern/console.h>
+
+
+// Collect the formatted output in a buffer on the stack and hand it
+// to the console a run at a time, rather than one cputchar (and one
+// pass over every console device) per character.
+struct printbuf {
+	int idx;	// current buffer index
+	int cnt;	// total bytes printed so far
+	char buf[128];
+};
 
 static void
-putch(int ch, int *cnt)
+bufwrite(const char *s, size_t len, void *ctx)
 {
-	cputchar(ch);
-	*cnt++;
+	struct printbuf *b = ctx;
+
+	b->cnt += len;
+	if (b->idx + len > sizeof(b->buf)) {
+		if (b->idx > 0)
+			cons_write(b->buf, b->idx);
+		b->idx = 0;
+		// Runs that would fill the buffer go straight out.
+		if (len >= sizeof(b->buf)) {
+			cons_write(s, len);
+			return;
+		}
+	}
+	memcpy(b->buf + b->idx, s, len);
+	b->idx += len;
 }
 
 int
 vcprintf(const char *fmt, va_list ap)
 {
-	int cnt = 0;
+	struct printbuf b;
 
-	vprintfmt((void*)putch, &cnt, fmt, ap);
-	return cnt;
+	b.idx = 0;
+	b.cnt = 0;
+	vwritefmt(bufwrite, &b, fmt, ap);
+	cons_write(b.buf, b.idx);
+
+	return b.cnt;
 }
 
 int
@@ -0,0 +1,59 @@
+#include <inc/assert.h>
+#include <inc/x86.h>
+
+#include <kern/env.h>
+#include <kern/pmap.h>
+#include <kern/monitor.h>
+#include <kern/sched.h>
+
+void sched_halt(void) __attribute__((noreturn));
+
+// Choose a user environment to run and run it.
+//
+// Search through 'envs' for an ENV_RUNNABLE environment in circular
+// fashion, starting just after the env this CPU was last running,
+// and switch to the first one found.  If none are runnable but the
+// previously running env is still ENV_RUNNING, keep running it.
+// Never picks an environment that is blocked or dying.
+void
+sched_yield(void)
+{
+	struct Env *idle;
+	int i, start;
+
+	start = curenv ? ENVX(curenv->env_id) + 1 : 0;
+	for (i = 0; i < NENV; i++) {
+		idle = &envs[(start + i) % NENV];
+		if (idle->env_status == ENV_RUNNABLE)
+			env_run(idle);
+	}
+
+	if (curenv && curenv->env_status == ENV_RUNNING)
+		env_run(curenv);
+
+	// sched_halt never returns
+	sched_halt();
+}
+
+// Nothing is runnable: drop into the kernel monitor.
+void
+sched_halt(void)
+{
+	int i;
+
+	for (i = 0; i < NENV; i++)
+		if (envs[i].env_status != ENV_FREE)
+			break;
+	if (i == NENV)
+		cprintf("Destroyed the only environment - nothing more to do!\n");
+	else
+		cprintf("No runnable environments in the system!\n");
+
+	// Mark that no environment is running on this CPU
+	env_save_tf();
+	curenv = NULL;
+	lcr3(PADDR(kern_pgdir));
+
+	while (1)
+		monitor(NULL);
+}
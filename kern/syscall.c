@@ -10,6 +10,7 @@
 #include <kern/trap.h>
 #include <kern/syscall.h>
 #include <kern/console.h>
+#include <kern/sched.h>
 
 
 // Returns the current environment's envid.
@@ -21,20 +22,13 @@ sys_getenvid(void)
 
 // Print a string to the system console.
 // The string is exactly 'len' characters long.
-// Destroys the environment on memory errors.
-static void
+// [s, s+len) has already been checked for PTE_U by the dispatcher.
+static int
 sys_cputs(const char *s, size_t len)
 {
-	// Check that the user has permission to read memory [s, s+len).
-	// Destroy the environment if not.
-
-	// LAB 3: Your code here.
-	struct Env *e;
-	envid2env(sys_getenvid(), &e, 1);
-	user_mem_assert(e, (void *)s, len, PTE_U);
-	
 	// Print the string supplied by the user.
-	cprintf("%.*s", len, s);
+	cons_write(s, len);
+	return 0;
 }
 
 // Read a character from the system console without blocking.
@@ -66,34 +60,624 @@ sys_env_destroy(envid_t envid)
 	return 0;
 }
 
+// Is 'va' one of the pages env_setup_kpages maps for the kernel?  The
+// kernel writes UVDSO through env_vdso and uses the ring at USYSRING
+// in sys_submit, so the environment may not replace or unmap them.
+static bool
+kpage_va(const void *va)
+{
+	return (uintptr_t) va == UVDSO || (uintptr_t) va == USYSRING;
+}
+
+// Check 'perm' as for sys_page_alloc: PTE_U | PTE_P must be set and
+// nothing outside PTE_SYSCALL may be.
+static bool
+perm_ok(int perm)
+{
+	return (perm & (PTE_U | PTE_P)) == (PTE_U | PTE_P) &&
+		!(perm & ~PTE_SYSCALL);
+}
+
+// Map the page at 'srcva' in src at 'dstva' in dst with 'perm',
+// without copying it.  The common part of sys_page_map and
+// sys_ipc_try_send; see sys_page_map for the errors.
+static int
+page_transfer(struct Env *src, void *srcva, struct Env *dst, void *dstva,
+	      int perm)
+{
+	struct PageInfo *p;
+	pte_t *pte;
+
+	if ((uintptr_t) srcva >= UTOP || PGOFF(srcva) ||
+	    (uintptr_t) dstva >= UTOP || PGOFF(dstva) || kpage_va(dstva))
+		return -E_INVAL;
+	if (!perm_ok(perm))
+		return -E_INVAL;
+	if (!(p = page_lookup(src->env_pgdir, srcva, &pte)))
+		return -E_INVAL;
+	if ((perm & PTE_W) && !(*pte & PTE_W))
+		return -E_INVAL;
+	return page_insert(dst->env_pgdir, p, dstva, perm);
+}
+
+// Deliver an IPC message from curenv to 'e', which must be blocked
+// receiving (from curenv, if it asked for a particular sender), and
+// make 'e' runnable.  If 'srcva' < UTOP and 'e' wants a page, the page
+// is mapped into 'e' at its dstva, without copying it.
+//
+// A receiver that blocked in sys_ipc_call or sys_ipc_reply_wait gets
+// the message in registers as well as in its Env: %eax = sender,
+// %edx = value, %ebx = perm.
+//
+// Returns 0 on success, < 0 on error (see sys_ipc_try_send).
+static int
+ipc_deliver(struct Env *e, uint32_t value, void *srcva, unsigned perm)
+{
+	int r;
+
+	if (!e->env_ipc_recving ||
+	    (e->env_ipc_waitfor && e->env_ipc_waitfor != curenv->env_id))
+		return -E_IPC_NOT_RECV;
+
+	e->env_ipc_perm = 0;
+	if ((uintptr_t) srcva < UTOP && (uintptr_t) e->env_ipc_dstva < UTOP) {
+		if ((r = page_transfer(curenv, srcva, e, e->env_ipc_dstva, perm)) < 0)
+			return r;
+		e->env_ipc_perm = perm;
+	} else if ((uintptr_t) srcva < UTOP && PGOFF(srcva))
+		return -E_INVAL;
+
+	e->env_ipc_recving = 0;
+	e->env_ipc_from = curenv->env_id;
+	e->env_ipc_value = value;
+	if (e->env_ipc_regs) {
+		e->env_tf.tf_regs.reg_eax = curenv->env_id;
+		e->env_tf.tf_regs.reg_edx = value;
+		e->env_tf.tf_regs.reg_ebx = e->env_ipc_perm;
+	}
+	e->env_status = ENV_RUNNABLE;
+	return 0;
+}
+
+// Mark curenv as blocked receiving at 'dstva', from 'from' only if
+// nonzero.  'regs' asks for the message in registers (see ipc_deliver).
+// Saves curenv's registers, with 0 as the system call's return value,
+// so the caller can go on to switch away.
+static void
+ipc_block(void *dstva, envid_t from, bool regs)
+{
+	curenv->env_ipc_recving = 1;
+	curenv->env_ipc_dstva = dstva;
+	curenv->env_ipc_waitfor = from;
+	curenv->env_ipc_regs = regs;
+	curenv->env_status = ENV_NOT_RUNNABLE;
+
+	env_save_tf();
+	curenv->env_tf.tf_regs.reg_eax = 0;
+}
+
+// Direct handoff after a successful send: rather than returning to
+// the sender and waiting for the scheduler to find the receiver,
+// switch straight to receiver 'e'.  The sender is left runnable,
+// with 0 as the return value of its system call.
+static void __attribute__((noreturn))
+ipc_handoff(struct Env *e)
+{
+	env_save_tf();
+	curenv->env_tf.tf_regs.reg_eax = 0;
+	env_run(e);
+}
+
+// Allocate a page of memory and map it at 'va' with permission
+// 'perm' in the address space of 'envid'.
+// The page's contents are set to 0.
+// If a page is already mapped at 'va', that page is unmapped as a
+// side effect.
+//
+// perm -- PTE_U | PTE_P must be set, PTE_AVAIL | PTE_W may or may not be set,
+//         but no other bits may be set.  See PTE_SYSCALL in inc/mmu.h.
+//
+// Return 0 on success, < 0 on error.  Errors are:
+//	-E_BAD_ENV if environment envid doesn't currently exist,
+//		or the caller doesn't have permission to change envid.
+//	-E_INVAL if va >= UTOP, or va is not page-aligned,
+//		or va is UVDSO or USYSRING.
+//	-E_INVAL if perm is inappropriate (see above).
+//	-E_NO_MEM if there's no memory to allocate the new page,
+//		or to allocate any necessary page tables.
+static int
+sys_page_alloc(envid_t envid, void *va, int perm)
+{
+	int r;
+	struct Env *e;
+	struct PageInfo *p;
+
+	if ((r = envid2env(envid, &e, 1)) < 0)
+		return r;
+	if ((uintptr_t) va >= UTOP || PGOFF(va) || kpage_va(va))
+		return -E_INVAL;
+	if (!perm_ok(perm))
+		return -E_INVAL;
+
+	if (!(p = page_alloc(ALLOC_ZERO)))
+		return -E_NO_MEM;
+	if ((r = page_insert(e->env_pgdir, p, va, perm)) < 0) {
+		page_free(p);
+		return r;
+	}
+	return 0;
+}
+
+// Set the page fault upcall for 'envid' by modifying the corresponding
+// struct Env's 'env_pgfault_upcall' field.  When 'envid' causes a page
+// fault, the kernel will push a fault record onto the exception stack,
+// then branch to 'func'.
+//
+// Returns 0 on success, < 0 on error.  Errors are:
+//	-E_BAD_ENV if environment envid doesn't currently exist,
+//		or the caller doesn't have permission to change envid.
+static int
+sys_env_set_pgfault_upcall(envid_t envid, void *func)
+{
+	int r;
+	struct Env *e;
+
+	if ((r = envid2env(envid, &e, 1)) < 0)
+		return r;
+	e->env_pgfault_upcall = func;
+	return 0;
+}
+
+// Deschedule current environment and pick a different one to run.
+static void
+sys_yield(void)
+{
+	sched_yield();
+}
+
+// Allocate a new environment.
+// Returns envid of new environment, or < 0 on error.  Errors are:
+//	-E_NO_FREE_ENV if no free environment is available.
+//	-E_NO_MEM on memory exhaustion.
+static envid_t
+sys_exofork(void)
+{
+	// Create the new environment with env_alloc(), from kern/env.c.
+	// It should be left as env_alloc created it, except that
+	// status is set to ENV_NOT_RUNNABLE, and the register set is copied
+	// from the current environment -- but tweaked so sys_exofork
+	// will appear to return 0.
+	int r;
+	struct Env *e;
+
+	if ((r = env_alloc(&e, curenv->env_id)) < 0)
+		return r;
+	e->env_status = ENV_NOT_RUNNABLE;
+	// The caller's registers are in its live trap frame, if any.
+	e->env_tf = curtf ? *curtf : curenv->env_tf;
+	e->env_tf.tf_regs.reg_eax = 0;
+	return e->env_id;
+}
+
+// Set envid's env_status to status, which must be ENV_RUNNABLE
+// or ENV_NOT_RUNNABLE.
+//
+// Returns 0 on success, < 0 on error.  Errors are:
+//	-E_BAD_ENV if environment envid doesn't currently exist,
+//		or the caller doesn't have permission to change envid.
+//	-E_INVAL if status is not a valid status for an environment.
+static int
+sys_env_set_status(envid_t envid, int status)
+{
+	int r;
+	struct Env *e;
+
+	if (status != ENV_RUNNABLE && status != ENV_NOT_RUNNABLE)
+		return -E_INVAL;
+	if ((r = envid2env(envid, &e, 1)) < 0)
+		return r;
+	if (e == curenv)
+		return -E_INVAL;
+	e->env_status = status;
+	return 0;
+}
+
+// Map the page of memory at 'srcva' in srcenvid's address space
+// at 'dstva' in dstenvid's address space with permission 'perm'.
+// Perm has the same restrictions as in sys_page_alloc, except
+// that it also must not grant write access to a read-only
+// page.
+//
+// Return 0 on success, < 0 on error.  Errors are:
+//	-E_BAD_ENV if srcenvid and/or dstenvid doesn't currently exist,
+//		or the caller doesn't have permission to change one of them.
+//	-E_INVAL if srcva >= UTOP or srcva is not page-aligned,
+//		or dstva >= UTOP or dstva is not page-aligned,
+//		or dstva is UVDSO or USYSRING.
+//	-E_INVAL is srcva is not mapped in srcenvid's address space.
+//	-E_INVAL if perm is inappropriate (see sys_page_alloc).
+//	-E_INVAL if (perm & PTE_W), but srcva is read-only in srcenvid's
+//		address space.
+//	-E_NO_MEM if there's no memory to allocate any necessary page tables.
+static int
+sys_page_map(envid_t srcenvid, void *srcva,
+	     envid_t dstenvid, void *dstva, int perm)
+{
+	int r;
+	struct Env *src, *dst;
+
+	if ((r = envid2env(srcenvid, &src, 1)) < 0 ||
+	    (r = envid2env(dstenvid, &dst, 1)) < 0)
+		return r;
+	return page_transfer(src, srcva, dst, dstva, perm);
+}
+
+// Unmap the page of memory at 'va' in the address space of 'envid'.
+// If no page is mapped, the function silently succeeds.
+//
+// Return 0 on success, < 0 on error.  Errors are:
+//	-E_BAD_ENV if environment envid doesn't currently exist,
+//		or the caller doesn't have permission to change envid.
+//	-E_INVAL if va >= UTOP, or va is not page-aligned,
+//		or va is UVDSO or USYSRING.
+static int
+sys_page_unmap(envid_t envid, void *va)
+{
+	int r;
+	struct Env *e;
+
+	if ((r = envid2env(envid, &e, 1)) < 0)
+		return r;
+	if ((uintptr_t) va >= UTOP || PGOFF(va) || kpage_va(va))
+		return -E_INVAL;
+	page_remove(e->env_pgdir, va);
+	return 0;
+}
+
+// Try to send 'value' to the target env 'envid'.
+// If srcva < UTOP, then also send page currently mapped at 'srcva',
+// so that receiver gets a duplicate mapping of the same page.
+//
+// The send fails with a return value of -E_IPC_NOT_RECV if the
+// target is not blocked, waiting for an IPC.
+//
+// The send also can fail for the other reasons listed below.
+//
+// Otherwise, the send succeeds, and the target's ipc fields are
+// updated as follows:
+//    env_ipc_recving is set to 0 to block future sends;
+//    env_ipc_from is set to the sending envid;
+//    env_ipc_value is set to the 'value' parameter;
+//    env_ipc_perm is set to 'perm' if a page was transferred, 0 otherwise.
+// The target environment is marked runnable again, and the current
+// environment hands the CPU straight to it (see ipc_handoff).
+//
+// If the sender wants to send a page but the receiver isn't asking for one,
+// then no page mapping is transferred, but no error occurs.
+// The ipc only happens when no errors occur.
+//
+// Returns 0 on success, < 0 on error.
+// Errors are:
+//	-E_BAD_ENV if environment envid doesn't currently exist.
+//		(No need to check permissions.)
+//	-E_IPC_NOT_RECV if envid is not currently blocked in sys_ipc_recv,
+//		or another environment managed to send first.
+//	-E_INVAL if srcva < UTOP but srcva is not page-aligned.
+//	-E_INVAL if srcva < UTOP and perm is inappropriate
+//		(see sys_page_alloc).
+//	-E_INVAL if srcva < UTOP but srcva is not mapped in the caller's
+//		address space.
+//	-E_INVAL if (perm & PTE_W), but srcva is read-only in the
+//		current environment's address space.
+//	-E_NO_MEM if there's not enough memory to map srcva in envid's
+//		address space.
+static int
+sys_ipc_try_send(envid_t envid, uint32_t value, void *srcva, unsigned perm)
+{
+	int r;
+	struct Env *e;
+
+	if ((r = envid2env(envid, &e, 0)) < 0)
+		return r;
+	if ((r = ipc_deliver(e, value, srcva, perm)) < 0)
+		return r;
+	ipc_handoff(e);
+}
+
+// Block until a value is ready.  Record that you want to receive
+// using the env_ipc_recving and env_ipc_dstva fields of struct Env,
+// mark yourself not runnable, and then give up the CPU.
+//
+// If 'dstva' is < UTOP, then you are willing to receive a page of data.
+// 'dstva' is the virtual address at which the sent page should be mapped.
+//
+// This function only returns on error, but the system call will eventually
+// return 0 on success.
+// Return < 0 on error.  Errors are:
+//	-E_INVAL if dstva < UTOP but dstva is not page-aligned.
+static int
+sys_ipc_recv(void *dstva)
+{
+	if ((uintptr_t) dstva < UTOP && PGOFF(dstva))
+		return -E_INVAL;
+
+	ipc_block(dstva, 0, 0);
+	sched_yield();
+}
+
+// Synchronous call: send 'value' (and the page at 'srcva', as in
+// sys_ipc_try_send) to 'envid', then wait for a reply from 'envid' only,
+// mapping any page it sends at 'dstva'.  The send and the wait happen
+// in one trap, and the CPU goes straight to 'envid'.
+//
+// On success the call returns the replying envid, with the reply value
+// in %edx and the reply page permission in %ebx (see lib/syscall.c).
+// Errors are as for sys_ipc_try_send and sys_ipc_recv; nothing is sent
+// on error, and the caller should retry on -E_IPC_NOT_RECV.
+static int
+sys_ipc_call(envid_t envid, uint32_t value, void *srcva, unsigned perm,
+	     void *dstva)
+{
+	int r;
+	struct Env *e;
+
+	if ((uintptr_t) dstva < UTOP && PGOFF(dstva))
+		return -E_INVAL;
+	if ((r = envid2env(envid, &e, 0)) < 0)
+		return r;
+	if (e == curenv)
+		return -E_INVAL;
+	if ((r = ipc_deliver(e, value, srcva, perm)) < 0)
+		return r;
+
+	ipc_block(dstva, e->env_id, 1);
+	env_run(e);
+}
+
+// Server side of sys_ipc_call: reply to 'envid' (if nonzero), then wait
+// for the next message from anyone, mapping any page at 'dstva'.
+// Replying to a client blocked in sys_ipc_call switches straight back
+// to it.
+//
+// Returns like sys_ipc_call, with the sender's envid in %eax.
+// Errors are as for sys_ipc_call; on error no reply was sent and the
+// caller is not waiting.
+static int
+sys_ipc_reply_wait(envid_t envid, uint32_t value, void *srcva,
+		   unsigned perm, void *dstva)
+{
+	int r;
+	struct Env *e = NULL;
+
+	if ((uintptr_t) dstva < UTOP && PGOFF(dstva))
+		return -E_INVAL;
+	if (envid) {
+		if ((r = envid2env(envid, &e, 0)) < 0)
+			return r;
+		if (e == curenv)
+			return -E_INVAL;
+		if ((r = ipc_deliver(e, value, srcva, perm)) < 0)
+			return r;
+	}
+
+	ipc_block(dstva, 0, 1);
+	if (e)
+		env_run(e);
+	sched_yield();
+}
+
+// Block until another environment calls sys_notify on us, unless the
+// word at 'addr' no longer holds 'val' or a notification is already
+// pending.  The check and the block happen together, so a change to
+// *addr or a notification that comes after the caller last looked at
+// *addr cannot be lost.  Meant for waiting on shared-memory indices
+// (see lib/chan.c).  Wakeups may be spurious.
+//
+// Returns 0 when woken or if it did not block; the environment is
+// destroyed if 'addr' is not readable.
+static int
+sys_notify_wait(const volatile uint32_t *addr, uint32_t val)
+{
+	user_mem_assert(curenv, (const void *) addr, sizeof(*addr), PTE_U);
+	if (curenv->env_notify_pending || *addr != val) {
+		curenv->env_notify_pending = 0;
+		return 0;
+	}
+
+	curenv->env_notify_waiting = 1;
+	curenv->env_status = ENV_NOT_RUNNABLE;
+	env_save_tf();
+	curenv->env_tf.tf_regs.reg_eax = 0;
+	sched_yield();
+}
+
+// Wake 'envid' if it is blocked in sys_notify_wait; otherwise make
+// its next sys_notify_wait return at once.  Does not switch: the
+// caller keeps running.
+//
+// Returns 0 on success, < 0 on error.  Errors are:
+//	-E_BAD_ENV if environment envid doesn't currently exist.
+//		(No need to check permissions.)
+static int
+sys_notify(envid_t envid)
+{
+	int r;
+	struct Env *e;
+
+	if ((r = envid2env(envid, &e, 0)) < 0)
+		return r;
+	if (e->env_notify_waiting) {
+		e->env_notify_waiting = 0;
+		e->env_status = ENV_RUNNABLE;
+	} else
+		e->env_notify_pending = 1;
+	return 0;
+}
+
+static bool syscall_batchable(uint32_t num);
+
+// Run the requests queued in the current environment's syscall ring
+// (see struct Sysring in inc/syscall.h), in order, and post one
+// completion for each.  Stops early when the completion ring is full.
+// A nested SYS_submit, or any call that may switch environments
+// (and so never return here), completes with -E_INVAL.
+//
+// Returns the number of requests run.
+static int
+sys_submit(void)
+{
+	struct Sysring *ring = (struct Sysring *) USYSRING;
+	struct SysSqe *sqe;
+	struct SysCqe *cqe;
+	uint32_t head, tail;
+	int r, n = 0;
+
+	// The environment can't unmap the ring, but check it anyway
+	// rather than risk a kernel page fault.
+	if ((r = user_mem_check(curenv, ring, PGSIZE, PTE_U | PTE_W)) < 0)
+		return r;
+
+	head = ring->sq_head;
+	tail = ring->sq_tail;
+	if (tail - head > SYSRING_NENT)
+		return -E_INVAL;
+
+	for (; head != tail; head++, n++) {
+		if (ring->cq_tail - ring->cq_head >= SYSRING_NENT)
+			break;
+		sqe = &ring->sq[head & SYSRING_MASK];
+		cqe = &ring->cq[ring->cq_tail & SYSRING_MASK];
+		cqe->data = sqe->data;
+		if (!syscall_batchable(sqe->num))
+			cqe->ret = -E_INVAL;
+		else
+			cqe->ret = syscall(sqe->num, sqe->args[0], sqe->args[1],
+					   sqe->args[2], sqe->args[3],
+					   sqe->args[4]);
+		ring->cq_tail++;
+		ring->sq_head = head + 1;
+	}
+	return n;
+}
+
+
+// System call table.
+//
+// Each entry describes one system call: its handler, and (optionally)
+// one user buffer argument that must be checked before the handler
+// runs.  'uptr' and
+// 'ulen' are 1-based argument indices; uptr == 0 means no buffer.
+// The handlers take their real argument types; they are called through
+// a generic five-argument pointer, which is safe under the cdecl
+// convention since the caller pops the arguments.
+//
+// SC_NOBATCH marks calls that sys_submit must not run: SYS_submit
+// itself, and calls that may switch to another environment instead
+// of returning.
+//
+// 'calls' and 'cycles' accumulate per-syscall profiling counters,
+// shown by the 'sysprof' monitor command.
+
+typedef int32_t (*syscall_fn_t)(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
+
+struct Syscall {
+	const char *name;
+	syscall_fn_t func;
+	uint8_t uptr;		// argument holding a user pointer, or 0
+	uint8_t ulen;		// argument holding its length in bytes
+	uint8_t uperm;		// PTE_* bits the buffer must carry
+	uint8_t flags;		// SC_*
+	uint32_t calls;
+	uint64_t cycles;
+};
+
+#define SC_NOBATCH	0x1
+
+#define SYSCALL(num, fn, p, l, perm, fl) \
+	[num] = { #fn, (syscall_fn_t) fn, p, l, perm, fl, 0, 0 }
+
+static struct Syscall syscalls[NSYSCALLS] = {
+	SYSCALL(SYS_cputs,	 sys_cputs,	  1, 2, PTE_U, 0),
+	SYSCALL(SYS_cgetc,	 sys_cgetc,	  0, 0, 0, 0),
+	SYSCALL(SYS_getenvid,	 sys_getenvid,	  0, 0, 0, 0),
+	SYSCALL(SYS_env_destroy, sys_env_destroy, 0, 0, 0, SC_NOBATCH),
+	SYSCALL(SYS_submit,	 sys_submit,	  0, 0, 0, SC_NOBATCH),
+	SYSCALL(SYS_page_alloc,	 sys_page_alloc,  0, 0, 0, 0),
+	SYSCALL(SYS_env_set_pgfault_upcall, sys_env_set_pgfault_upcall, 0, 0, 0, 0),
+	SYSCALL(SYS_exofork,	 sys_exofork,	  0, 0, 0, 0),
+	SYSCALL(SYS_env_set_status, sys_env_set_status, 0, 0, 0, 0),
+	SYSCALL(SYS_page_map,	 sys_page_map,	  0, 0, 0, 0),
+	SYSCALL(SYS_page_unmap,	 sys_page_unmap,  0, 0, 0, 0),
+	SYSCALL(SYS_yield,	 sys_yield,	  0, 0, 0, SC_NOBATCH),
+	SYSCALL(SYS_ipc_try_send, sys_ipc_try_send, 0, 0, 0, SC_NOBATCH),
+	SYSCALL(SYS_ipc_recv,	 sys_ipc_recv,	  0, 0, 0, SC_NOBATCH),
+	SYSCALL(SYS_ipc_call,	 sys_ipc_call,	  0, 0, 0, SC_NOBATCH),
+	SYSCALL(SYS_ipc_reply_wait, sys_ipc_reply_wait, 0, 0, 0, SC_NOBATCH),
+	SYSCALL(SYS_notify_wait, sys_notify_wait, 0, 0, 0, SC_NOBATCH),
+	SYSCALL(SYS_notify,	 sys_notify,	  0, 0, 0, 0),
+};
+
+// Can 'num' be queued in the syscall ring?
+static bool
+syscall_batchable(uint32_t num)
+{
+	return num < NSYSCALLS && !(syscalls[num].flags & SC_NOBATCH);
+}
+
 // Dispatches to the correct kernel function, passing the arguments.
 int32_t
 syscall(uint32_t syscallno, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5)
 {
-	// Call the function corresponding to the 'syscallno' parameter.
-	// Return any appropriate return value.
-	// LAB 3: Your code here.
-	int ret = 0;
+	uint32_t a[6] = { 0, a1, a2, a3, a4, a5 };
+	struct Syscall *sc;
+	uint64_t start;
+	int32_t ret;
 
-	switch (syscallno) {
-		case SYS_cputs:
-			sys_cputs((char *)a1, a2);
-			ret = 0;
-			break;
-		case SYS_cgetc:
-			ret = sys_cgetc();
-			break;
-		case SYS_getenvid:
-			ret = sys_getenvid();
-			break;
-		case SYS_env_destroy:
-			sys_env_destroy(a1);
-			ret = 0;
-			break;		
-	default:
+	if (syscallno >= NSYSCALLS || !syscalls[syscallno].func)
 		return -E_NO_SYS;
-	}
+	sc = &syscalls[syscallno];
+
+	// Check the user buffer argument, if any.
+	// Destroys the environment on memory errors.
+	if (sc->uptr)
+		user_mem_assert(curenv, (void *) a[sc->uptr], a[sc->ulen],
+				sc->uperm);
+
+	// Count the call first: switching calls may not come back,
+	// in which case their cycles are not recorded.
+	sc->calls++;
+	start = read_tsc();
+	ret = sc->func(a1, a2, a3, a4, a5);
+	sc->cycles += read_tsc() - start;
 
 	return ret;
 }
 
+// Print the per-syscall call counts and cycle totals.
+void
+syscall_print_stats(void)
+{
+	int i;
+
+	cprintf("syscall               calls               cycles        avg\n");
+	for (i = 0; i < NSYSCALLS; i++) {
+		if (!syscalls[i].func)
+			continue;
+		cprintf("%-16s %10u %20llu %10llu\n", syscalls[i].name,
+			syscalls[i].calls, syscalls[i].cycles,
+			syscalls[i].calls ?
+				syscalls[i].cycles / syscalls[i].calls : 0);
+	}
+}
+
+// Zero the per-syscall profiling counters.
+void
+syscall_reset_stats(void)
+{
+	int i;
+
+	for (i = 0; i < NSYSCALLS; i++) {
+		syscalls[i].calls = 0;
+		syscalls[i].cycles = 0;
+	}
+}
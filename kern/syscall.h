@@ -7,5 +7,7 @@
 #include <inc/syscall.h>
 
 int32_t syscall(uint32_t num, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5);
+void syscall_print_stats(void);
+void syscall_reset_stats(void);
 
 #endif /* !JOS_KERN_SYSCALL_H */
@@ -0,0 +1,42 @@
+/* See COPYRIGHT for copyright information. */
+
+#include <inc/stdio.h>
+#include <inc/string.h>
+
+#include <kern/trace.h>
+
+struct Trace trace;
+
+// Print the recorded traps, oldest first.  A negative 'trapno' or a
+// zero 'envid' matches any record.  TSC values are printed relative
+// to the oldest record shown.
+void
+trace_dump(int trapno, envid_t envid)
+{
+	uint32_t i, first;
+	uint64_t base = 0;
+	struct TraceRec *r;
+	int shown = 0;
+
+	first = trace.next > NTRACE ? trace.next - NTRACE : 0;
+	for (i = first; i != trace.next; i++) {
+		r = &trace.recs[i & (NTRACE - 1)];
+		if (trapno >= 0 && r->tr_trapno != trapno)
+			continue;
+		if (envid && r->tr_envid != envid)
+			continue;
+		if (!shown++)
+			base = r->tr_tsc;
+		cprintf("%5u +%12llu  trap %3u  eip %08x  env %08x\n",
+			i, r->tr_tsc - base, r->tr_trapno, r->tr_eip,
+			r->tr_envid);
+	}
+	cprintf("%d of %u records shown\n", shown,
+		trace.next - first);
+}
+
+void
+trace_clear(void)
+{
+	memset(&trace, 0, sizeof(trace));
+}
@@ -0,0 +1,52 @@
+/* See COPYRIGHT for copyright information. */
+
+#ifndef JOS_KERN_TRACE_H
+#define JOS_KERN_TRACE_H
+#ifndef JOS_KERNEL
+# error "This is a JOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/trap.h>
+#include <inc/env.h>
+#include <inc/x86.h>
+
+// In-memory trap trace.
+//
+// trap() appends one fixed-size binary record per trap to a ring of
+// NTRACE entries, overwriting the oldest.  Only the kernel writes the
+// ring, with interrupts disabled, so no locking is needed.  The
+// 'trace' monitor command formats the records on demand.
+
+#define NTRACE		1024		// must be a power of 2
+
+struct TraceRec {
+	uint64_t tr_tsc;		// TSC at trap entry
+	uint32_t tr_trapno;		// Trap number
+	uintptr_t tr_eip;		// Trapping instruction pointer
+	envid_t tr_envid;		// Current env, or 0 if none
+	uint32_t tr_padding;
+};
+
+struct Trace {
+	uint32_t next;			// Free-running index of next record
+	struct TraceRec recs[NTRACE];
+};
+
+extern struct Trace trace;
+
+static inline void
+trace_trap(const struct Trapframe *tf, envid_t envid)
+{
+	struct TraceRec *r = &trace.recs[trace.next++ & (NTRACE - 1)];
+
+	r->tr_tsc = read_tsc();
+	r->tr_trapno = tf->tf_trapno;
+	r->tr_eip = tf->tf_eip;
+	r->tr_envid = envid;
+}
+
+void trace_dump(int trapno, envid_t envid);
+void trace_clear(void);
+
+#endif /* !JOS_KERN_TRACE_H */
@@ -8,6 +8,8 @@
 #include <kern/monitor.h>
 #include <kern/env.h>
 #include <kern/syscall.h>
+#include <kern/trace.h>
+#include <kern/fpu.h>
 
 static struct Taskstate ts;
 
@@ -55,6 +57,8 @@ static const char *trapname(int trapno)
 		return excnames[trapno];
 	if (trapno == T_SYSCALL)
 		return "System call";
+	if (trapno >= IRQ_OFFSET && trapno < IRQ_OFFSET + 16)
+		return "Hardware Interrupt";
 	return "(unknown trap)";
 }
 
@@ -84,6 +88,8 @@ trap_init(void)
 	void handler_mchk();
 	void handler_simderr();
 	void handler_syscall();
+	void handler_irq_serial();
+	void handler_irq_spurious();
 
 	SETGATE(idt[T_DIVIDE], 0, GD_KT, handler_divide, 0);
 	SETGATE(idt[T_DEBUG], 0, GD_KT, handler_debug, 0);
@@ -104,6 +110,8 @@ trap_init(void)
 	SETGATE(idt[T_MCHK], 0, GD_KT, handler_mchk, 0);
 	SETGATE(idt[T_SIMDERR], 0, GD_KT, handler_simderr, 0);
 	SETGATE(idt[T_SYSCALL], 0, GD_KT, handler_syscall, 3);
+	SETGATE(idt[IRQ_OFFSET + IRQ_SERIAL], 0, GD_KT, handler_irq_serial, 0);
+	SETGATE(idt[IRQ_OFFSET + IRQ_SPURIOUS], 0, GD_KT, handler_irq_spurious, 0);
 
 	// Per-CPU setup 
 	trap_init_percpu();
@@ -202,6 +210,26 @@ trap_dispatch(struct Trapframe *tf)
 		monitor(tf);
 		return;
 	}
+
+	if (tf->tf_trapno == T_DEVICE && (tf->tf_cs & 3) == 3) {
+		fpu_trap();
+		return;
+	}
+
+	// Handle spurious interrupts
+	// The hardware sometimes raises these because of noise on the
+	// IRQ line or other reasons. We don't care.
+	if (tf->tf_trapno == IRQ_OFFSET + IRQ_SPURIOUS) {
+		cprintf("Spurious interrupt on irq 7\n");
+		print_trapframe(tf);
+		return;
+	}
+
+	// The UART wants more output, or has input for us.
+	if (tf->tf_trapno == IRQ_OFFSET + IRQ_SERIAL) {
+		serial_intr();
+		return;
+	}
 	
 	
 	// Unexpected trap: The user process or the kernel has a bug.
@@ -226,18 +254,16 @@ trap(struct Trapframe *tf)
 	// the interrupt path.
 	assert(!(read_eflags() & FL_IF));
 
-	cprintf("Incoming TRAP frame at %p\n", tf);
+	trace_trap(tf, curenv ? curenv->env_id : 0);
 
 	if ((tf->tf_cs & 0b11) == 0b11) {
 		// Trapped from user mode.
 		assert(curenv);
 
-		// Copy trap frame (which is currently on the stack)
-		// into 'curenv->env_tf', so that running the environment
-		// will restart at the trap point.
-		curenv->env_tf = *tf;
-		// The trapframe on the stack should be ignored from here on.
-		tf = &curenv->env_tf;
+		// Work on the trap frame in place on the kernel stack.
+		// It is copied into 'curenv->env_tf' by env_save_tf()
+		// only if we switch away from curenv.
+		curtf = tf;
 	}
 
 	// Record that tf is the last real trapframe so
@@ -249,6 +275,10 @@ trap(struct Trapframe *tf)
 
 	// Return to the current environment, which should be running.
 	assert(curenv && curenv->env_status == ENV_RUNNING);
+	// Fast path: the trap came from curenv and we never left it,
+	// so its address space is loaded and its frame is still live.
+	if (tf == curtf)
+		env_pop_tf(tf);
 	env_run(curenv);
 }
 
@@ -270,6 +300,34 @@ page_fault_handler(struct Trapframe *tf)
 	// We've already handled kernel-mode exceptions, so if we get here,
 	// the page fault happened in user mode.
 
+	// If the env has a page fault upcall, push a UTrapframe onto its
+	// exception stack and resume it at the upcall, which returns to
+	// the faulting instruction without entering the kernel again.
+	// A fault taken while already on the exception stack is pushed
+	// below the current frame, leaving one empty word that the
+	// upcall uses to return.  The env is destroyed if the exception
+	// stack is unmapped, not writable, or overflows.
+	if (curenv->env_pgfault_upcall) {
+		struct UTrapframe *utf;
+		uintptr_t top = UXSTACKTOP;
+
+		if (tf->tf_esp >= UXSTACKTOP - PGSIZE && tf->tf_esp < UXSTACKTOP)
+			top = tf->tf_esp - 4;
+		utf = (struct UTrapframe *) (top - sizeof(struct UTrapframe));
+		user_mem_assert(curenv, utf, sizeof(struct UTrapframe), PTE_W);
+
+		utf->utf_fault_va = fault_va;
+		utf->utf_err = tf->tf_err;
+		utf->utf_regs = tf->tf_regs;
+		utf->utf_eip = tf->tf_eip;
+		utf->utf_eflags = tf->tf_eflags;
+		utf->utf_esp = tf->tf_esp;
+
+		tf->tf_eip = (uintptr_t) curenv->env_pgfault_upcall;
+		tf->tf_esp = (uintptr_t) utf;
+		return;
+	}
+
 	// Destroy the environment that caused the fault.
 	cprintf("[%08x] user fault va %08x ip %08x\n",
 		curenv->env_id, fault_va, tf->tf_eip);
@@ -0,0 +1,143 @@
+// Shared-memory byte channels between environments.
+// See inc/chan.h for the layout.
+
+#include <inc/lib.h>
+
+// Order our index update against reading the other side's waiter
+// field, and vice versa (the classic store-then-load race).
+static inline void
+mb(void)
+{
+	asm volatile("lock; addl $0,0(%%esp)" : : : "memory");
+}
+
+// Create a channel at 'c' with 'npages' data pages ('npages' must be
+// a power of two).  The pages are mapped PTE_SHARE, so a child forked
+// afterwards shares the channel; chan_share maps it into another env.
+// Returns 0 on success, < 0 on error.
+int
+chan_create(struct Chan *c, size_t npages)
+{
+	size_t i;
+	int r;
+
+	if (!npages || (npages & (npages - 1)) || PGOFF(c))
+		return -E_INVAL;
+	for (i = 0; i <= npages; i++)
+		if ((r = sys_page_alloc(0, (uint8_t *) c + i * PGSIZE,
+					PTE_P | PTE_U | PTE_W | PTE_SHARE)) < 0)
+			return r;
+	c->size = npages * PGSIZE;
+	return 0;
+}
+
+// Map the channel at 'c' into 'envid' at the same address.
+int
+chan_share(struct Chan *c, envid_t envid)
+{
+	size_t i;
+	int r;
+
+	for (i = 0; i <= c->size / PGSIZE; i++)
+		if ((r = sys_page_map(0, (uint8_t *) c + i * PGSIZE,
+				      envid, (uint8_t *) c + i * PGSIZE,
+				      PTE_P | PTE_U | PTE_W | PTE_SHARE)) < 0)
+			return r;
+	return 0;
+}
+
+// Wake the environment parked in *waiter, if any.
+static void
+chan_wake(volatile envid_t *waiter)
+{
+	envid_t id;
+
+	mb();
+	if ((id = *waiter) != 0) {
+		*waiter = 0;
+		sys_notify(id);
+	}
+}
+
+// Sleep until *idx moves from 'seen', publishing ourselves in *waiter.
+static void
+chan_sleep(volatile envid_t *waiter, volatile uint32_t *idx, uint32_t seen)
+{
+	*waiter = thisenv->env_id;
+	mb();
+	// sys_notify_wait returns at once if *idx has already moved,
+	// or if we were notified since publishing *waiter.
+	sys_notify_wait(idx, seen);
+	*waiter = 0;
+}
+
+// Copy 'n' bytes from 'buf' into the channel, waiting for space as
+// needed.  Returns n.
+ssize_t
+chan_send(struct Chan *c, const void *buf, size_t n)
+{
+	const uint8_t *p = buf;
+	uint32_t head, tail, off, m;
+	size_t left = n;
+
+	while (left) {
+		tail = c->tail;
+		while ((head = c->head) + c->size == tail)
+			chan_sleep(&c->wwaiter, &c->head, head);
+
+		off = tail & (c->size - 1);
+		m = MIN(MIN(left, head + c->size - tail), c->size - off);
+		memcpy(c->data + off, p, m);
+		p += m;
+		left -= m;
+
+		// Publish the data before the index.
+		asm volatile("" : : : "memory");
+		c->tail = tail + m;
+		// The reader may have drained the ring and parked since we
+		// read 'head', so check for it after every move; this
+		// makes a system call only if it is actually waiting.
+		chan_wake(&c->rwaiter);
+	}
+	return n;
+}
+
+// Copy up to 'n' bytes from the channel into 'buf', waiting until at
+// least one byte is available.  Returns the number of bytes read, or
+// 0 if the channel is empty and has been closed.
+ssize_t
+chan_recv(struct Chan *c, void *buf, size_t n)
+{
+	uint32_t head, tail, off, m;
+
+	head = c->head;
+	while ((tail = c->tail) == head) {
+		// The writer may send its last bytes and close between
+		// our reads, so only give up if the ring is still empty
+		// after seeing 'closed'.
+		if (c->closed) {
+			if ((tail = c->tail) != head)
+				break;
+			return 0;
+		}
+		chan_sleep(&c->rwaiter, &c->tail, tail);
+	}
+
+	off = head & (c->size - 1);
+	m = MIN(MIN(n, tail - head), c->size - off);
+	memcpy(buf, c->data + off, m);
+
+	asm volatile("" : : : "memory");
+	c->head = head + m;
+	// As in chan_send: the writer may have parked after we read 'tail'.
+	chan_wake(&c->wwaiter);
+	return m;
+}
+
+// Close the writing end: once drained, chan_recv returns 0.
+void
+chan_close(struct Chan *c)
+{
+	c->closed = 1;
+	chan_wake(&c->rwaiter);
+}
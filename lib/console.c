@@ -2,6 +2,91 @@
 #include <inc/string.h>
 #include <inc/lib.h>
 
+// Console output buffer.  cputchar and cprintf collect output here and
+// hand it to the kernel with one sys_cputs per buffer, instead of one
+// per character or per call.  It is flushed when full, by cflush, at
+// exit, in panic and before blocking for input, and also:
+//	CBUF_LINE (default): at the end of any call that wrote a newline;
+//	CBUF_FULL: only then;
+//	CBUF_NONE: at the end of every call.
+static struct {
+	char buf[256];
+	int idx;
+	int mode;
+	bool nl;		// buffer holds a newline (CBUF_LINE)
+	int hold;		// inside vcprintf: defer the end-of-call flush
+} cout = { .mode = CBUF_LINE };
+
+void
+cflush(void)
+{
+	if (cout.idx > 0)
+		sys_cputs(cout.buf, cout.idx);
+	cout.idx = 0;
+	cout.nl = 0;
+}
+
+// Set the buffering mode and return the old one.
+int
+csetbuf(int mode)
+{
+	int old = cout.mode;
+
+	cflush();
+	cout.mode = mode;
+	return old;
+}
+
+// End of an output call: flush as the buffering mode asks.
+static void
+cendwrite(void)
+{
+	if (cout.hold)
+		return;
+	if (cout.mode == CBUF_NONE || (cout.mode == CBUF_LINE && cout.nl))
+		cflush();
+}
+
+// Append 'len' bytes to the console buffer.
+void
+cwrite(const char *s, size_t len)
+{
+	size_t n;
+
+	if (cout.mode == CBUF_LINE && memfind(s, '\n', len) != s + len)
+		cout.nl = 1;
+	while (len > 0) {
+		if (cout.idx == sizeof(cout.buf))
+			cflush();
+		// Long runs go straight out.
+		if (cout.idx == 0 && len >= sizeof(cout.buf)) {
+			sys_cputs(s, len);
+			break;
+		}
+		n = MIN(len, sizeof(cout.buf) - cout.idx);
+		memcpy(cout.buf + cout.idx, s, n);
+		cout.idx += n;
+		s += n;
+		len -= n;
+	}
+	cendwrite();
+}
+
+// Group everything written until cend() into one output call, so that
+// a line-buffered flush does not split it.
+void
+cbegin(void)
+{
+	cout.hold++;
+}
+
+void
+cend(void)
+{
+	cout.hold--;
+	cendwrite();
+}
+
 void
 cputchar(int ch)
 {
@@ -9,17 +94,19 @@ cputchar(int ch)
 
 	// Unlike standard Unix's putchar,
 	// the cputchar function _always_ outputs to the system console.
-	sys_cputs(&c, 1);
+	cwrite(&c, 1);
 }
 
 int
 getchar(void)
 {
 	int r;
+
+	// Show any prompt before waiting.
+	cflush();
 	// sys_cgetc does not block, but getchar should.
 	while ((r = sys_cgetc()) == 0)
 		;
 	return r;
 }
 
-
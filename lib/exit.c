@@ -4,6 +4,7 @@
 void
 exit(void)
 {
+	cflush();
 	sys_env_destroy(0);
 }
 
@@ -0,0 +1,122 @@
+// implement fork from user space
+
+#include <inc/string.h>
+#include <inc/lib.h>
+
+// PTE_COW marks copy-on-write page table entries.
+// It is one of the bits explicitly allocated to user processes (PTE_AVAIL).
+#define PTE_COW		0x800
+
+//
+// Custom page fault handler - if faulting page is copy-on-write,
+// map in our own private writable copy.
+//
+static void
+pgfault(struct UTrapframe *utf)
+{
+	void *addr = (void *) utf->utf_fault_va;
+	uint32_t err = utf->utf_err;
+	int r;
+
+	// Check that the faulting access was (1) a write, and (2) to a
+	// copy-on-write page.  If not, panic.
+	if (!(err & FEC_WR) || !(uvpd[PDX(addr)] & PTE_P) ||
+	    (uvpt[PGNUM(addr)] & (PTE_P | PTE_COW)) != (PTE_P | PTE_COW))
+		panic("pgfault: va %08x err %x eip %08x",
+		      addr, err, utf->utf_eip);
+
+	// Allocate a new page, map it at a temporary location (PFTEMP),
+	// copy the data from the old page to the new page, then move the new
+	// page to the old page's address.
+	addr = ROUNDDOWN(addr, PGSIZE);
+	if ((r = sys_page_alloc(0, PFTEMP, PTE_P | PTE_U | PTE_W)) < 0)
+		panic("pgfault: sys_page_alloc: %e", r);
+	memmove(PFTEMP, addr, PGSIZE);
+	if ((r = sys_page_map(0, PFTEMP, 0, addr, PTE_P | PTE_U | PTE_W)) < 0)
+		panic("pgfault: sys_page_map: %e", r);
+	if ((r = sys_page_unmap(0, PFTEMP)) < 0)
+		panic("pgfault: sys_page_unmap: %e", r);
+}
+
+//
+// Map our virtual page pn (address pn*PGSIZE) into the target envid
+// at the same virtual address.  If the page is writable or copy-on-write,
+// the new mapping must be created copy-on-write, and then our mapping must be
+// marked copy-on-write as well.  (Exercise: Why do we need to mark ours
+// copy-on-write again if it was already copy-on-write at the beginning of
+// this function?)
+//
+// Returns: 0 on success, < 0 on error.
+//
+static int
+duppage(envid_t envid, unsigned pn)
+{
+	void *va = (void *) (pn * PGSIZE);
+	pte_t pte = uvpt[pn];
+	int r;
+
+	if (pte & PTE_SHARE)
+		return sys_page_map(0, va, envid, va, pte & PTE_SYSCALL);
+	if (pte & (PTE_W | PTE_COW)) {
+		if ((r = sys_page_map(0, va, envid, va,
+				      PTE_P | PTE_U | PTE_COW)) < 0)
+			return r;
+		return sys_page_map(0, va, 0, va, PTE_P | PTE_U | PTE_COW);
+	}
+	return sys_page_map(0, va, envid, va, PTE_P | PTE_U);
+}
+
+//
+// User-level fork with copy-on-write.
+// Set up our page fault handler appropriately.
+// Create a child.
+// Copy our address space and page fault handler setup to the child.
+// Then mark the child as runnable and return.
+//
+// Returns: child's envid to the parent, 0 to the child, < 0 on error.
+//
+// The UVDSO and USYSRING pages are per-environment and already set up
+// by the kernel in the child, and the child needs its own fresh
+// exception stack, so none of the three is duplicated.
+//
+envid_t
+fork(void)
+{
+	extern void _pgfault_upcall(void);
+	envid_t envid;
+	uintptr_t va;
+	int r;
+
+	set_pgfault_handler(pgfault);
+	// Otherwise the child inherits a copy of unflushed output.
+	cflush();
+
+	if ((envid = sys_exofork()) < 0)
+		return envid;
+	if (envid == 0) {
+		thisenv = &envs[ENVX(sys_getenvid())];
+		return 0;
+	}
+
+	for (va = 0; va < USTACKTOP; va += PGSIZE) {
+		if (va == UVDSO || va == USYSRING)
+			continue;
+		if (!(uvpd[PDX(va)] & PTE_P)) {
+			va += PTSIZE - PGSIZE;
+			continue;
+		}
+		if ((uvpt[PGNUM(va)] & (PTE_P | PTE_U)) != (PTE_P | PTE_U))
+			continue;
+		if ((r = duppage(envid, PGNUM(va))) < 0)
+			panic("fork: duppage %08x: %e", va, r);
+	}
+
+	if ((r = sys_page_alloc(envid, (void *) (UXSTACKTOP - PGSIZE),
+				PTE_P | PTE_U | PTE_W)) < 0)
+		panic("fork: sys_page_alloc: %e", r);
+	if ((r = sys_env_set_pgfault_upcall(envid, _pgfault_upcall)) < 0)
+		panic("fork: sys_env_set_pgfault_upcall: %e", r);
+	if ((r = sys_env_set_status(envid, ENV_RUNNABLE)) < 0)
+		panic("fork: sys_env_set_status: %e", r);
+	return envid;
+}
@@ -0,0 +1,112 @@
+// User-level IPC library routines
+
+#include <inc/lib.h>
+
+// Receive a value via IPC and return it.
+// If 'pg' is nonnull, then any page sent by the sender will be mapped at
+//	that address.
+// If 'from_env_store' is nonnull, then store the IPC sender's envid in
+//	*from_env_store.
+// If 'perm_store' is nonnull, then store the IPC sender's page permission
+//	in *perm_store (this is nonzero iff a page was successfully
+//	transferred to 'pg').
+// If the system call fails, then store 0 in *fromenv and *perm (if
+//	they're nonnull) and return the error.
+// Otherwise, return the value sent by the sender
+//
+// The page is mapped, not copied: sender and receiver share it.
+int32_t
+ipc_recv(envid_t *from_env_store, void *pg, int *perm_store)
+{
+	int r;
+
+	// UTOP means "no page".
+	if ((r = sys_ipc_recv(pg ? pg : (void *) UTOP)) < 0) {
+		if (from_env_store)
+			*from_env_store = 0;
+		if (perm_store)
+			*perm_store = 0;
+		return r;
+	}
+	if (from_env_store)
+		*from_env_store = thisenv->env_ipc_from;
+	if (perm_store)
+		*perm_store = thisenv->env_ipc_perm;
+	return thisenv->env_ipc_value;
+}
+
+// Send 'val' (and 'pg' with 'perm', if 'pg' is nonnull) to 'toenv'.
+// This function keeps trying until it succeeds.
+// It should panic() on any error other than -E_IPC_NOT_RECV.
+//
+// On success the kernel switches straight to 'toenv'; we run again
+// when the scheduler next picks us.
+void
+ipc_send(envid_t to_env, uint32_t val, void *pg, int perm)
+{
+	int r;
+
+	while ((r = sys_ipc_try_send(to_env, val, pg ? pg : (void *) UTOP,
+				     perm)) == -E_IPC_NOT_RECV)
+		sys_yield();
+	if (r < 0)
+		panic("ipc_send: %e", r);
+}
+
+// Find the first environment of the given type.  We'll use this to
+// find special environments.
+// Returns 0 if no such environment exists.
+envid_t
+ipc_find_env(enum EnvType type)
+{
+	int i;
+	for (i = 0; i < NENV; i++)
+		if (envs[i].env_type == type)
+			return envs[i].env_id;
+	return 0;
+}
+
+// Send 'val' (and 'pg' with 'perm', if 'pg' is nonnull) to the server
+// 'to_env' and wait for its reply, which is returned.  A page in the
+// reply is mapped at 'pg'.  If 'perm_store' is nonnull, the reply's
+// page permission is stored there.
+// Retries until the server is waiting; panics on any other error.
+int32_t
+ipc_call(envid_t to_env, uint32_t val, void *pg, int perm, int *perm_store)
+{
+	int r;
+
+	pg = pg ? pg : (void *) UTOP;
+	while ((r = sys_ipc_call(to_env, &val, pg, &perm, pg)) == -E_IPC_NOT_RECV)
+		sys_yield();
+	if (r < 0)
+		panic("ipc_call: %e", r);
+	if (perm_store)
+		*perm_store = perm;
+	return val;
+}
+
+// Reply 'val' (and 'pg' with 'perm', if 'pg' is nonnull) to the client
+// 'to_env', or to nobody if 'to_env' is 0, then wait for the next
+// request.  The request's sender is stored in *from_env_store, and its
+// page permission in *perm_store (if they're nonnull); any page it
+// sends is mapped at 'pg'.  Returns the request value.
+// A reply to a client that is no longer waiting is dropped.
+int32_t
+ipc_reply_wait(envid_t to_env, uint32_t val, void *pg, int perm,
+	       envid_t *from_env_store, int *perm_store)
+{
+	int r;
+
+	pg = pg ? pg : (void *) UTOP;
+	r = sys_ipc_reply_wait(to_env, &val, pg, &perm, pg);
+	if (r == -E_IPC_NOT_RECV || r == -E_BAD_ENV)
+		r = sys_ipc_reply_wait(0, &val, pg, &perm, pg);
+	if (r < 0)
+		panic("ipc_reply_wait: %e", r);
+	if (from_env_store)
+		*from_env_store = r;
+	if (perm_store)
+		*perm_store = perm;
+	return val;
+}
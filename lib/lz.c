@@ -0,0 +1,75 @@
+// LZ4 block decoder, for images packed by boot/lzpack.
+//
+// A block is a series of sequences.  Each starts with a token byte
+// whose high nibble is a literal count and low nibble a match length
+// minus 4; a nibble of 15 continues in following bytes, each added in,
+// until one is not 255.  The literals come next, then a 2-byte little
+// endian offset back into the output and the match length extension.
+// The last sequence stops after its literals.
+
+#include <inc/string.h>
+#include <inc/error.h>
+#include <inc/lz.h>
+
+// Read the extension bytes of a length nibble into *len.
+static const uint8_t *
+lz_len(const uint8_t *ip, const uint8_t *iend, size_t *len)
+{
+	if (*len != 15)
+		return ip;
+	do {
+		if (ip >= iend)
+			return NULL;
+		*len += *ip;
+	} while (*ip++ == 255);
+	return ip;
+}
+
+// Decode the block of srclen bytes at src into dst, which has room
+// for dstlen bytes.  Returns the number of bytes written, or
+// -E_INVAL if the block is corrupt or does not fit.
+int
+lz_decode(void *dst, size_t dstlen, const void *src, size_t srclen)
+{
+	const uint8_t *ip = src, *iend = ip + srclen;
+	uint8_t *op = dst, *oend = op + dstlen;
+	const uint8_t *m;
+	size_t len, off;
+	uint8_t token;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		len = token >> 4;
+		if (!(ip = lz_len(ip, iend, &len))
+		    || len > iend - ip || len > oend - op)
+			return -E_INVAL;
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return -E_INVAL;
+		off = ip[0] | (ip[1] << 8);
+		ip += 2;
+		len = token & 15;
+		if (!(ip = lz_len(ip, iend, &len)))
+			return -E_INVAL;
+		len += 4;
+		if (off == 0 || off > op - (uint8_t *) dst || len > oend - op)
+			return -E_INVAL;
+
+		// A match may overlap its own output (a run), which
+		// must be replicated forward a byte at a time.
+		m = op - off;
+		if (off >= len) {
+			memcpy(op, m, len);
+			op += len;
+		} else
+			while (len-- > 0)
+				*op++ = *m++;
+	}
+	return op - (uint8_t *) dst;
+}
@@ -13,6 +13,9 @@ _panic(const char *file, int line, const char *fmt, ...)
 
 	va_start(ap, fmt);
 
+	// Print what was buffered, and the message straight after it
+	csetbuf(CBUF_NONE);
+
 	// Print the panic message
 	cprintf("[%08x] user panic in %s at %s:%d: ",
 		sys_getenvid(), binaryname, file, line);
@@ -11,40 +11,28 @@
 #include <inc/lib.h>
 
 
-// Collect up to 256 characters into a buffer
-// and perform ONE system call to print all of them,
-// in order to make the lines output to the console atomic
-// and prevent interrupts from causing context switches
-// in the middle of a console output line and such.
-struct printbuf {
-	int idx;	// current buffer index
-	int cnt;	// total bytes printed so far
-	char buf[256];
-};
-
+// Output goes through the console buffer in lib/console.c, as one
+// output call per cprintf: a line-buffered flush happens only at the
+// end of the call, so that the lines output to the console are atomic
+// and a context switch cannot split one.
 
 static void
-putch(int ch, struct printbuf *b)
+countwrite(const char *s, size_t len, void *ctx)
 {
-	b->buf[b->idx++] = ch;
-	if (b->idx == 256-1) {
-		sys_cputs(b->buf, b->idx);
-		b->idx = 0;
-	}
-	b->cnt++;
+	*(int *) ctx += len;
+	cwrite(s, len);
 }
 
 int
 vcprintf(const char *fmt, va_list ap)
 {
-	struct printbuf b;
+	int cnt = 0;
 
-	b.idx = 0;
-	b.cnt = 0;
-	vprintfmt((void*)putch, &b, fmt, ap);
-	sys_cputs(b.buf, b.idx);
+	cbegin();
+	vwritefmt(countwrite, &cnt, fmt, ap);
+	cend();
 
-	return b.cnt;
+	return cnt;
 }
 
 int
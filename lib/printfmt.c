@@ -26,27 +26,77 @@ static const char * const error_string[MAXERROR] =
 	[E_NO_MEM]	= "out of memory",
 	[E_NO_FREE_ENV]	= "out of environments",
 	[E_FAULT]	= "segmentation fault",
+	[E_NO_SYS]	= "unimplemented system call",
+	[E_IPC_NOT_RECV]= "env is not recving",
 };
 
+// Two-digit groups for the number conversion below.
+static const char digits10[200] =
+	"00010203040506070809101112131415161718192021222324"
+	"25262728293031323334353637383940414243444546474849"
+	"50515253545556575859606162636465666768697071727374"
+	"75767778798081828384858687888990919293949596979899";
+
+static const char digits16[] = "0123456789abcdef";
+
+// Write 'n' copies of 'padc'.
+static void
+writepad(void (*write)(const char *, size_t, void *), void *ctx,
+	 int padc, int n)
+{
+	char pad[16];
+	int m;
+
+	if (n <= 0)
+		return;
+	memset(pad, padc, MIN(n, (int) sizeof(pad)));
+	for (; n > 0; n -= m)
+		write(pad, m = MIN(n, (int) sizeof(pad)), ctx);
+}
+
 /*
- * Print a number (base <= 16) in reverse order,
- * using specified putch function and associated pointer putdat.
+ * Print a number (base <= 16), padded on the left with padc to 'width',
+ * using the specified write function and associated pointer ctx.
+ * The digits are produced right to left into a buffer, two at a time
+ * for base 10, and written in one piece.
  */
 static void
-printnum(void (*putch)(int, void*), void *putdat,
+printnum(void (*write)(const char *, size_t, void *), void *ctx,
 	 unsigned long long num, unsigned base, int width, int padc)
 {
-	// first recursively print all preceding (more significant) digits
-	if (num >= base) {
-		printnum(putch, putdat, num / base, base, width - 1, padc);
+	char buf[24];		// 64 bits in octal, 22 digits
+	char *p = buf + sizeof(buf);
+	uint32_t n;
+
+	// Divide 64-bit numbers down to 32 bits first; 64-bit division
+	// is a library call on this machine.
+	while (num > 0xFFFFFFFFULL) {
+		*--p = digits16[num % base];
+		num /= base;
+	}
+	n = num;
+	if (base == 10) {
+		for (; n >= 100; n /= 100) {
+			p -= 2;
+			memcpy(p, &digits10[(n % 100) * 2], 2);
+		}
+		if (n >= 10) {
+			p -= 2;
+			memcpy(p, &digits10[n * 2], 2);
+		} else
+			*--p = '0' + n;
+	} else if (base == 16) {
+		for (; n >= 16; n >>= 4)
+			*--p = digits16[n & 0xF];
+		*--p = digits16[n];
 	} else {
-		// print any needed pad characters before first digit
-		while (--width > 0)
-			putch(padc, putdat);
+		for (; n >= base; n /= base)
+			*--p = digits16[n % base];
+		*--p = digits16[n];
 	}
 
-	// then print this (the least significant) digit
-	putch("0123456789abcdef"[num % base], putdat);
+	writepad(write, ctx, padc, width - (int) (buf + sizeof(buf) - p));
+	write(p, buf + sizeof(buf) - p, ctx);
 }
 
 // Get an unsigned int of various possible sizes from a varargs list,
@@ -77,23 +127,25 @@ getint(va_list *ap, int lflag)
 
 
 // Main function to format and print a string.
-void printfmt(void (*putch)(int, void*), void *putdat, const char *fmt, ...);
-
+// Output goes to write(ptr, len, ctx) in runs: each stretch of
+// literal text between escapes, and each formatted field, is one call
+// (or a few, for wide padding).
 void
-vprintfmt(void (*putch)(int, void*), void *putdat, const char *fmt, va_list ap)
+vwritefmt(void (*write)(const char *, size_t, void *), void *ctx, const char *fmt, va_list ap)
 {
 	register const char *p;
 	register int ch, err;
 	unsigned long long num;
-	int base, lflag, width, precision, altflag;
-	char padc;
+	int base, lflag, width, precision, altflag, len, i;
+	char padc, c;
 
 	while (1) {
-		while ((ch = *(unsigned char *) fmt++) != '%') {
-			if (ch == '\0')
-				return;
-			putch(ch, putdat);
-		}
+		for (p = fmt; *fmt != '%' && *fmt != '\0'; fmt++)
+			/* do nothing */;
+		if (fmt > p)
+			write(p, fmt - p, ctx);
+		if (*fmt++ == '\0')
+			return;
 
 		// Process a %-escape sequence
 		padc = ' ';
@@ -157,7 +209,8 @@ vprintfmt(void (*putch)(int, void*), void *putdat, const char *fmt, va_list ap)
 
 		// character
 		case 'c':
-			putch(va_arg(ap, int), putdat);
+			c = va_arg(ap, int);
+			write(&c, 1, ctx);
 			break;
 
 		// error message
@@ -166,32 +219,34 @@ vprintfmt(void (*putch)(int, void*), void *putdat, const char *fmt, va_list ap)
 			if (err < 0)
 				err = -err;
 			if (err >= MAXERROR || (p = error_string[err]) == NULL)
-				printfmt(putch, putdat, "error %d", err);
+				writefmt(write, ctx, "error %d", err);
 			else
-				printfmt(putch, putdat, "%s", p);
+				write(p, strlen(p), ctx);
 			break;
 
 		// string
 		case 's':
 			if ((p = va_arg(ap, char *)) == NULL)
 				p = "(null)";
-			if (width > 0 && padc != '-')
-				for (width -= strnlen(p, precision); width > 0; width--)
-					putch(padc, putdat);
-			for (; (ch = *p++) != '\0' && (precision < 0 || --precision >= 0); width--)
-				if (altflag && (ch < ' ' || ch > '~'))
-					putch('?', putdat);
-				else
-					putch(ch, putdat);
-			for (; width > 0; width--)
-				putch(' ', putdat);
+			len = strnlen(p, precision);
+			if (padc != '-')
+				writepad(write, ctx, padc, width - len);
+			if (!altflag)
+				write(p, len, ctx);
+			else
+				for (i = 0; i < len; i++) {
+					c = (p[i] < ' ' || p[i] > '~') ? '?' : p[i];
+					write(&c, 1, ctx);
+				}
+			if (padc == '-')
+				writepad(write, ctx, ' ', width - len);
 			break;
 
 		// (signed) decimal
 		case 'd':
 			num = getint(&ap, lflag);
 			if ((long long) num < 0) {
-				putch('-', putdat);
+				write("-", 1, ctx);
 				num = -(long long) num;
 			}
 			base = 10;
@@ -211,8 +266,7 @@ vprintfmt(void (*putch)(int, void*), void *putdat, const char *fmt, va_list ap)
 
 		// pointer
 		case 'p':
-			putch('0', putdat);
-			putch('x', putdat);
+			write("0x", 2, ctx);
 			num = (unsigned long long)
 				(uintptr_t) va_arg(ap, void *);
 			base = 16;
@@ -223,17 +277,17 @@ vprintfmt(void (*putch)(int, void*), void *putdat, const char *fmt, va_list ap)
 			num = getuint(&ap, lflag);
 			base = 16;
 		number:
-			printnum(putch, putdat, num, base, width, padc);
+			printnum(write, ctx, num, base, width, padc);
 			break;
 
 		// escaped '%' character
 		case '%':
-			putch(ch, putdat);
+			write("%", 1, ctx);
 			break;
 
 		// unrecognized escape sequence - just print it literally
 		default:
-			putch('%', putdat);
+			write("%", 1, ctx);
 			for (fmt--; fmt[-1] != '%'; fmt--)
 				/* do nothing */;
 			break;
@@ -241,6 +295,39 @@ vprintfmt(void (*putch)(int, void*), void *putdat, const char *fmt, va_list ap)
 	}
 }
 
+void
+writefmt(void (*write)(const char *, size_t, void *), void *ctx, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vwritefmt(write, ctx, fmt, ap);
+	va_end(ap);
+}
+
+// The putch interface: vprintfmt feeds each byte of each run to putch.
+struct putchctx {
+	void (*putch)(int, void*);
+	void *putdat;
+};
+
+static void
+putchwrite(const char *buf, size_t len, void *ctx)
+{
+	struct putchctx *pc = ctx;
+
+	while (len-- > 0)
+		pc->putch(*(unsigned char *) buf++, pc->putdat);
+}
+
+void
+vprintfmt(void (*putch)(int, void*), void *putdat, const char *fmt, va_list ap)
+{
+	struct putchctx pc = { putch, putdat };
+
+	vwritefmt(putchwrite, &pc, fmt, ap);
+}
+
 void
 printfmt(void (*putch)(int, void*), void *putdat, const char *fmt, ...)
 {
@@ -258,11 +345,14 @@ struct sprintbuf {
 };
 
 static void
-sprintputch(int ch, struct sprintbuf *b)
+sprintwrite(const char *s, size_t len, void *ctx)
 {
-	b->cnt++;
-	if (b->buf < b->ebuf)
-		*b->buf++ = ch;
+	struct sprintbuf *b = ctx;
+	size_t n = MIN(len, (size_t) (b->ebuf - b->buf));
+
+	b->cnt += len;
+	memcpy(b->buf, s, n);
+	b->buf += n;
 }
 
 int
@@ -274,7 +364,7 @@ vsnprintf(char *buf, int n, const char *fmt, va_list ap)
 		return -E_INVAL;
 
 	// print the string to the buffer
-	vprintfmt((void*)sprintputch, &b, fmt, ap);
+	vwritefmt(sprintwrite, &b, fmt, ap);
 
 	// null terminate the buffer
 	*b.buf = '\0';
@@ -295,4 +385,3 @@ snprintf(char *buf, int n, const char *fmt, ...)
 	return rc;
 }
 
-
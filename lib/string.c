@@ -1,6 +1,9 @@
-// Basic string routines.  Not hardware optimized, but not shabby.
+// Basic string routines.  The scans and copies work a word at a time,
+// with SSE2 for long buffers in user space.
 
 #include <inc/string.h>
+#include <inc/mmu.h>
+#include <inc/x86.h>
 
 // Using assembly for memset/memmove
 // makes some difference on real hardware,
@@ -8,24 +11,146 @@
 // Primespipe runs 3x faster this way.
 #define ASM 1
 
+// The scanning routines work a 32-bit word at a time: an unaligned
+// head one byte at a time, then aligned words, then the tail.  An
+// aligned word never crosses a page, so reading a whole word that
+// holds the end of a string is safe.
+//
+// HASZERO(x) is nonzero iff some byte of x is zero.  Bytes above the
+// first zero byte may be flagged spuriously by the borrow, but the
+// lowest flagged byte is always the first zero byte in memory.
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+#define ONES		0x01010101U
+#define HIGHS		0x80808080U
+#define HASZERO(x)	(((x) - ONES) & ~(x) & HIGHS)
+#define REPEAT(c)	(ONES * (uint8_t) (c))
+#define FIRSTBYTE(m)	(__builtin_ctz(m) / 8)
+
+// User environments additionally use SSE2 for long scans and copies,
+// when CPUID reports it.  The kernel never touches the FPU/SSE state
+// (it belongs to whichever env last used it), so it sticks to words;
+// a user env's first SSE2 instruction simply takes the lazy FPU trap.
+#ifdef JOS_USER
+#define SSE2_SCAN	64	// bytes scanned by words before using SSE2
+#define SSE2_COPY	256	// smallest copy worth SSE2
+#define SSE2		__attribute__((target("sse2")))
+
+static int sse2 = -1;
+
+static int
+have_sse2(void)
+{
+	uint32_t edx;
+
+	if (sse2 < 0) {
+		cpuid(1, NULL, NULL, NULL, &edx);
+		sse2 = (edx >> 26) & 1;
+	}
+	return sse2;
+}
+
+// Return a mask with bit i set iff byte i of the 16 bytes at p
+// equals the corresponding byte of pat.  p must be 16-byte aligned.
+static SSE2 __inline uint32_t
+sse2_match(const void *p, const uint32_t *pat)
+{
+	uint32_t m;
+
+	asm("movdqu %2, %%xmm0\n\t"
+	    "pcmpeqb %1, %%xmm0\n\t"
+	    "pmovmskb %%xmm0, %0"
+	    : "=r" (m)
+	    : "m" (*(const char (*)[16]) p), "m" (*(const uint32_t (*)[4]) pat)
+	    : "xmm0");
+	return m;
+}
+
+// Return a pointer to the first byte equal to c in [p, p + n),
+// or p + n.  p must be 16-byte aligned, but n need not be a multiple
+// of 16: the last block may overrun, never across a page.
+static SSE2 const char *
+sse2_find(const char *p, int c, size_t n)
+{
+	uint32_t pat[4], m;
+	const char *end = p + n;
+
+	pat[0] = pat[1] = pat[2] = pat[3] = REPEAT(c);
+	for (; p < end; p += 16)
+		if ((m = sse2_match(p, pat)) != 0) {
+			p += __builtin_ctz(m);
+			return p < end ? p : end;
+		}
+	return end;
+}
+
+// Return a pointer to the NUL ending the string containing p.
+// p must be 16-byte aligned.
+static SSE2 const char *
+sse2_strend(const char *p)
+{
+	static const uint32_t zero[4];
+	uint32_t m;
+
+	while (!(m = sse2_match(p, zero)))
+		p += 16;
+	return p + __builtin_ctz(m);
+}
+
+// Copy n >= 64 bytes forward, 64 at a time with the destination
+// aligned.  Safe for overlap as long as d <= s.
+static SSE2 void
+sse2_copy(char *d, const char *s, size_t n)
+{
+	size_t h = -(uintptr_t) d % 16;
+
+	n -= h;
+	asm volatile("cld; rep movsb" : "+D" (d), "+S" (s), "+c" (h)
+		     : : "cc", "memory");
+	for (; n >= 64; n -= 64, d += 64, s += 64)
+		asm volatile("movdqu (%1), %%xmm0\n\t"
+			     "movdqu 16(%1), %%xmm1\n\t"
+			     "movdqu 32(%1), %%xmm2\n\t"
+			     "movdqu 48(%1), %%xmm3\n\t"
+			     "movdqa %%xmm0, (%0)\n\t"
+			     "movdqa %%xmm1, 16(%0)\n\t"
+			     "movdqa %%xmm2, 32(%0)\n\t"
+			     "movdqa %%xmm3, 48(%0)"
+			     : : "r" (d), "r" (s)
+			     : "xmm0", "xmm1", "xmm2", "xmm3", "memory");
+	asm volatile("cld; rep movsb" : "+D" (d), "+S" (s), "+c" (n)
+		     : : "cc", "memory");
+}
+#else
+#define have_sse2()	0
+#define SSE2_SCAN	0
+#define SSE2_COPY	0
+#define sse2_find(p, c, n)	(p)
+#define sse2_strend(p)		(p)
+#define sse2_copy(d, s, n)	do { } while (0)
+#endif
+
 int
 strlen(const char *s)
 {
-	int n;
-
-	for (n = 0; *s != '\0'; s++)
-		n++;
-	return n;
+	const char *p = s;
+	const word_t *w;
+	uint32_t m;
+
+	for (; (uintptr_t) p % 4; p++)
+		if (*p == '\0')
+			return p - s;
+	for (w = (const word_t *) p; !(m = HASZERO(*w)); w++)
+		if (SSE2_SCAN && (const char *) w - s >= SSE2_SCAN
+		    && (uintptr_t) w % 16 == 0 && have_sse2())
+			return sse2_strend((const char *) w) - s;
+	return (const char *) w + FIRSTBYTE(m) - s;
 }
 
 int
 strnlen(const char *s, size_t size)
 {
-	int n;
-
-	for (n = 0; size > 0 && *s != '\0'; s++, size--)
-		n++;
-	return n;
+	return (const char *) memfind(s, '\0', size) - s;
 }
 
 char *
@@ -76,9 +201,31 @@ strlcpy(char *dst, const char *src, size_t size)
 	return dst - dst_in;
 }
 
+// Compares words once p is aligned.  q is read unaligned, except
+// where a word of it would cross into the next page, since the string
+// may end just before that page.
 int
 strcmp(const char *p, const char *q)
 {
+	uint32_t a;
+	int i;
+
+	for (; (uintptr_t) p % 4; p++, q++)
+		if (*p == '\0' || *p != *q)
+			goto bytes;
+	for (;;) {
+		if ((uintptr_t) q % PGSIZE > PGSIZE - 4) {
+			for (i = 0; i < 4; i++, p++, q++)
+				if (*p == '\0' || *p != *q)
+					goto bytes;
+			continue;
+		}
+		a = *(const word_t *) p;
+		if (a != *(const word_t *) q || HASZERO(a))
+			break;
+		p += 4, q += 4;
+	}
+bytes:
 	while (*p && *p == *q)
 		p++, q++;
 	return (int) ((unsigned char) *p - (unsigned char) *q);
@@ -100,10 +247,8 @@ strncmp(const char *p, const char *q, size_t n)
 char *
 strchr(const char *s, char c)
 {
-	for (; *s; s++)
-		if (*s == c)
-			return (char *) s;
-	return 0;
+	s = strfind(s, c);
+	return *s ? (char *) s : 0;
 }
 
 // Return a pointer to the first occurrence of 'c' in 's',
@@ -111,10 +256,15 @@ strchr(const char *s, char c)
 char *
 strfind(const char *s, char c)
 {
-	for (; *s; s++)
-		if (*s == c)
-			break;
-	return (char *) s;
+	const word_t *w;
+	uint32_t cc = REPEAT(c), m;
+
+	for (; (uintptr_t) s % 4; s++)
+		if (*s == '\0' || *s == c)
+			return (char *) s;
+	for (w = (const word_t *) s; !(m = HASZERO(*w) | HASZERO(*w ^ cc)); w++)
+		/* do nothing */;
+	return (char *) w + FIRSTBYTE(m);
 }
 
 #if ASM
@@ -138,32 +288,50 @@ memset(void *v, int c, size_t n)
 	return v;
 }
 
+// Copies of 16 bytes or more move single bytes only until the
+// destination is word aligned, then words (the source may stay
+// misaligned, which x86 handles at a small cost), then the last
+// 0-3 bytes.  Shorter copies just use movsb.
 void *
 memmove(void *dst, const void *src, size_t n)
 {
 	const char *s;
 	char *d;
+	size_t h;
 
 	s = src;
 	d = dst;
 	if (s < d && s + n > d) {
 		s += n;
 		d += n;
-		if ((int)s%4 == 0 && (int)d%4 == 0 && n%4 == 0)
-			asm volatile("std; rep movsl\n"
-				:: "D" (d-4), "S" (s-4), "c" (n/4) : "cc", "memory");
-		else
+		if (n < 16)
 			asm volatile("std; rep movsb\n"
 				:: "D" (d-1), "S" (s-1), "c" (n) : "cc", "memory");
+		else {
+			h = (uintptr_t) d % 4;
+			d--, s--;
+			asm volatile("std; rep movsb\n"
+				"subl $3, %%edi; subl $3, %%esi\n"
+				"movl %3, %%ecx; shrl $2, %%ecx; rep movsl\n"
+				"addl $3, %%edi; addl $3, %%esi\n"
+				"movl %3, %%ecx; andl $3, %%ecx; rep movsb\n"
+				: "+D" (d), "+S" (s), "+c" (h)
+				: "r" (n - h) : "cc", "memory");
+		}
 		// Some versions of GCC rely on DF being clear
 		asm volatile("cld" ::: "cc");
-	} else {
-		if ((int)s%4 == 0 && (int)d%4 == 0 && n%4 == 0)
-			asm volatile("cld; rep movsl\n"
-				:: "D" (d), "S" (s), "c" (n/4) : "cc", "memory");
-		else
-			asm volatile("cld; rep movsb\n"
-				:: "D" (d), "S" (s), "c" (n) : "cc", "memory");
+	} else if (SSE2_COPY && n >= SSE2_COPY && have_sse2())
+		sse2_copy(d, s, n);
+	else if (n < 16)
+		asm volatile("cld; rep movsb\n"
+			:: "D" (d), "S" (s), "c" (n) : "cc", "memory");
+	else {
+		h = -(uintptr_t) d % 4;
+		asm volatile("cld; rep movsb\n"
+			"movl %3, %%ecx; shrl $2, %%ecx; rep movsl\n"
+			"movl %3, %%ecx; andl $3, %%ecx; rep movsb\n"
+			: "+D" (d), "+S" (s), "+c" (h)
+			: "r" (n - h) : "cc", "memory");
 	}
 	return dst;
 }
@@ -211,12 +379,17 @@ memcpy(void *dst, const void *src, size_t n)
 	return memmove(dst, src, n);
 }
 
+// Skips equal words (both buffers are known to hold n bytes, so
+// unaligned loads are safe), then finds the differing byte.
 int
 memcmp(const void *v1, const void *v2, size_t n)
 {
 	const uint8_t *s1 = (const uint8_t *) v1;
 	const uint8_t *s2 = (const uint8_t *) v2;
 
+	for (; n >= 4; n -= 4, s1 += 4, s2 += 4)
+		if (*(const word_t *) s1 != *(const word_t *) s2)
+			break;
 	while (n-- > 0) {
 		if (*s1 != *s2)
 			return (int) *s1 - (int) *s2;
@@ -229,11 +402,33 @@ memcmp(const void *v1, const void *v2, size_t n)
 void *
 memfind(const void *s, int c, size_t n)
 {
-	const void *ends = (const char *) s + n;
-	for (; s < ends; s++)
-		if (*(const unsigned char *) s == (unsigned char) c)
+	const char *p = s, *end;
+	const word_t *w;
+	uint32_t cc = REPEAT(c), m;
+
+	// strnlen(s, -1) means no limit: stop at the top of the address
+	// space rather than wrapping around below s.
+	if (n > (uintptr_t) -1 - (uintptr_t) s)
+		end = (const char *) (uintptr_t) -1;
+	else
+		end = p + n;
+
+	for (; p < end && (uintptr_t) p % 4; p++)
+		if (*p == (char) c)
+			return (void *) p;
+	if (SSE2_SCAN && (size_t) (end - p) >= SSE2_SCAN && have_sse2()) {
+		for (; (uintptr_t) p % 16; p += 4)
+			if ((m = HASZERO(*(const word_t *) p ^ cc)) != 0)
+				return (void *) (p + FIRSTBYTE(m));
+		return (void *) sse2_find(p, c, end - p);
+	}
+	for (w = (const word_t *) p; (size_t) (end - (const char *) w) >= 4; w++)
+		if ((m = HASZERO(*w ^ cc)) != 0)
+			return (char *) w + FIRSTBYTE(m);
+	for (p = (const char *) w; p < end; p++)
+		if (*p == (char) c)
 			break;
-	return (void *) s;
+	return (void *) p;
 }
 
 long
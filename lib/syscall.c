@@ -55,9 +55,115 @@ sys_env_destroy(envid_t envid)
 	return syscall(SYS_env_destroy, 1, envid, 0, 0, 0, 0);
 }
 
+// No trap needed: the kernel keeps our envid in the UVDSO page.
 envid_t
 sys_getenvid(void)
 {
-	 return syscall(SYS_getenvid, 0, 0, 0, 0, 0, 0);
+	return vdso.vd_envid;
 }
 
+
+int
+sys_submit(void)
+{
+	return syscall(SYS_submit, 0, 0, 0, 0, 0, 0);
+}
+
+int
+sys_page_alloc(envid_t envid, void *va, int perm)
+{
+	return syscall(SYS_page_alloc, 1, envid, (uint32_t) va, perm, 0, 0);
+}
+
+int
+sys_env_set_pgfault_upcall(envid_t envid, void *upcall)
+{
+	return syscall(SYS_env_set_pgfault_upcall, 1, envid, (uint32_t) upcall, 0, 0, 0);
+}
+
+void
+sys_yield(void)
+{
+	syscall(SYS_yield, 0, 0, 0, 0, 0, 0);
+}
+
+int
+sys_env_set_status(envid_t envid, int status)
+{
+	return syscall(SYS_env_set_status, 1, envid, status, 0, 0, 0);
+}
+
+int
+sys_page_map(envid_t srcenv, void *srcva, envid_t dstenv, void *dstva, int perm)
+{
+	return syscall(SYS_page_map, 1, srcenv, (uint32_t) srcva, dstenv, (uint32_t) dstva, perm);
+}
+
+int
+sys_page_unmap(envid_t envid, void *va)
+{
+	return syscall(SYS_page_unmap, 1, envid, (uint32_t) va, 0, 0, 0);
+}
+
+int
+sys_ipc_try_send(envid_t envid, uint32_t value, void *srcva, int perm)
+{
+	return syscall(SYS_ipc_try_send, 0, envid, value, (uint32_t) srcva, perm, 0);
+}
+
+int
+sys_ipc_recv(void *dstva)
+{
+	return syscall(SYS_ipc_recv, 1, (uint32_t)dstva, 0, 0, 0, 0);
+}
+
+// sys_ipc_call and sys_ipc_reply_wait return the message in registers:
+// the sender's envid in %eax, the value in %edx and the page
+// permission in %ebx.  *value and *perm carry the outgoing message in
+// and the incoming one out.
+static inline int32_t
+ipc_syscall(int num, envid_t envid, uint32_t *value, void *srcva,
+	    int *perm, void *dstva)
+{
+	int32_t ret;
+	uint32_t edx = envid, ebx = (uint32_t) srcva;
+
+	asm volatile("int %3\n"
+		: "=a" (ret), "+d" (edx), "+b" (ebx)
+		: "i" (T_SYSCALL),
+		  "0" (num),
+		  "c" (*value),
+		  "D" (*perm),
+		  "S" (dstva)
+		: "cc", "memory");
+
+	if (ret > 0) {
+		*value = edx;
+		*perm = ebx;
+	}
+	return ret;
+}
+
+int
+sys_ipc_call(envid_t envid, uint32_t *value, void *srcva, int *perm, void *dstva)
+{
+	return ipc_syscall(SYS_ipc_call, envid, value, srcva, perm, dstva);
+}
+
+int
+sys_ipc_reply_wait(envid_t envid, uint32_t *value, void *srcva, int *perm, void *dstva)
+{
+	return ipc_syscall(SYS_ipc_reply_wait, envid, value, srcva, perm, dstva);
+}
+
+int
+sys_notify_wait(const volatile uint32_t *addr, uint32_t val)
+{
+	return syscall(SYS_notify_wait, 0, (uint32_t) addr, val, 0, 0, 0);
+}
+
+int
+sys_notify(envid_t envid)
+{
+	return syscall(SYS_notify, 0, envid, 0, 0, 0, 0);
+}
@@ -0,0 +1,49 @@
+// Batched system calls through the ring mapped at USYSRING.
+// Queue requests with sysring_queue(), run them all with one
+// sys_submit() trap, then collect results with sysring_reap().
+
+#include <inc/lib.h>
+
+#define ring	((struct Sysring *) USYSRING)
+
+// Queue system call 'num' with its arguments.
+// 'data' is returned unchanged with the completion.
+// Returns 0 on success, -E_NO_MEM if the submission ring is full.
+int
+sysring_queue(int num, uint32_t a1, uint32_t a2, uint32_t a3,
+	      uint32_t a4, uint32_t a5, uint32_t data)
+{
+	struct SysSqe *sqe;
+
+	if (ring->sq_tail - ring->sq_head >= SYSRING_NENT)
+		return -E_NO_MEM;
+	sqe = &ring->sq[ring->sq_tail & SYSRING_MASK];
+	sqe->num = num;
+	sqe->args[0] = a1;
+	sqe->args[1] = a2;
+	sqe->args[2] = a3;
+	sqe->args[3] = a4;
+	sqe->args[4] = a5;
+	sqe->data = data;
+	ring->sq_tail++;
+	return 0;
+}
+
+// Pop the oldest completion.  Stores its return value in *ret and
+// its submission's data word in *data (either may be null).
+// Returns 0 on success, -E_INVAL if no completion is waiting.
+int
+sysring_reap(int32_t *ret, uint32_t *data)
+{
+	struct SysCqe *cqe;
+
+	if (ring->cq_head == ring->cq_tail)
+		return -E_INVAL;
+	cqe = &ring->cq[ring->cq_head & SYSRING_MASK];
+	if (ret)
+		*ret = cqe->ret;
+	if (data)
+		*data = cqe->data;
+	ring->cq_head++;
+	return 0;
+}
@@ -0,0 +1,21 @@
+// Trap-free accessors for the kernel data page mapped at UVDSO.
+
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+// Microseconds since the kernel calibrated the TSC at boot.
+uint64_t
+vdso_time_usec(void)
+{
+	if (!vdso.vd_tsc_khz)
+		return 0;
+	return (read_tsc() - vdso.vd_tsc_boot) * 1000 / vdso.vd_tsc_khz;
+}
+
+// Number of times the kernel has dispatched an environment,
+// as of the last time this environment was dispatched.
+uint32_t
+vdso_ticks(void)
+{
+	return vdso.vd_ticks;
+}
@@ -0,0 +1,59 @@
+// Stream bytes from a parent to a forked child through a shared-memory
+// channel (lib/chan.c) and report the throughput.
+
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define CHAN	((struct Chan *) 0x30000000)
+#define NPAGES	16
+#define NBYTES	(64 << 20)
+#define CHUNK	PGSIZE
+
+static uint8_t buf[CHUNK];
+
+static void
+reader(void)
+{
+	uint32_t total = 0;
+	ssize_t n;
+
+	while ((n = chan_recv(CHAN, buf, sizeof(buf))) > 0)
+		total += n;
+	ipc_send(thisenv->env_parent_id, total, 0, 0);
+}
+
+void
+umain(int argc, char **argv)
+{
+	envid_t who;
+	uint64_t t0, t1, bps;
+	uint32_t i, total;
+	int r;
+
+	if ((r = chan_create(CHAN, NPAGES)) < 0)
+		panic("chan_create: %e", r);
+	if ((who = fork()) < 0)
+		panic("fork: %e", who);
+	if (who == 0) {
+		reader();
+		return;
+	}
+
+	memset(buf, 0xa5, sizeof(buf));
+	t0 = read_tsc();
+	for (i = 0; i < NBYTES; i += CHUNK)
+		chan_send(CHAN, buf, CHUNK);
+	chan_close(CHAN);
+	total = ipc_recv(0, 0, 0);
+	t1 = read_tsc();
+
+	if (total != NBYTES)
+		panic("chanbench: reader got %u bytes, want %u", total, NBYTES);
+	cprintf("%u bytes through a %d-page channel: %llu cycles\n",
+		NBYTES, NPAGES, t1 - t0);
+	if (vdso.vd_tsc_khz && t1 > t0) {
+		bps = (uint64_t) NBYTES * vdso.vd_tsc_khz * 1000 / (t1 - t0);
+		cprintf("  %llu.%03llu GB/s\n", bps / 1000000000,
+			bps / 1000000 % 1000);
+	}
+}
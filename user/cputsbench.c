@@ -0,0 +1,31 @@
+// Time bulk console output through sys_cputs and report bytes/sec.
+
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define LINELEN	80
+#define NLINES	200
+
+static char line[LINELEN];
+
+void
+umain(int argc, char **argv)
+{
+	uint64_t t0, t1;
+	int i;
+
+	memset(line, '.', LINELEN - 1);
+	line[LINELEN - 1] = '\n';
+
+	t0 = read_tsc();
+	for (i = 0; i < NLINES; i++)
+		sys_cputs(line, LINELEN);
+	t1 = read_tsc();
+
+	cprintf("%d bytes in %d sys_cputs: %llu cycles\n",
+		LINELEN * NLINES, NLINES, t1 - t0);
+	if (vdso.vd_tsc_khz && t1 > t0)
+		cprintf("  %llu bytes/sec\n",
+			(uint64_t) LINELEN * NLINES * vdso.vd_tsc_khz * 1000 /
+			(t1 - t0));
+}
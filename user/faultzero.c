@@ -0,0 +1,43 @@
+// Demand-zero heap: the page fault handler maps a fresh zero page
+// the first time each heap page is touched, one trap per page.
+
+#include <inc/lib.h>
+
+#define HEAP	0x10000000
+#define NPAGES	64
+
+static int nfaults;
+
+static void
+handler(struct UTrapframe *utf)
+{
+	uintptr_t va = utf->utf_fault_va;
+	int r;
+
+	if (va < HEAP || va >= HEAP + NPAGES * PGSIZE)
+		panic("unexpected fault at %08x, eip %08x", va, utf->utf_eip);
+	if ((r = sys_page_alloc(0, ROUNDDOWN((void *) va, PGSIZE),
+				PTE_P | PTE_U | PTE_W)) < 0)
+		panic("allocating at %08x in page fault handler: %e", va, r);
+	nfaults++;
+}
+
+void
+umain(int argc, char **argv)
+{
+	uint32_t *heap = (uint32_t *) HEAP;
+	int i, n = NPAGES * PGSIZE / sizeof(uint32_t);
+
+	set_pgfault_handler(handler);
+
+	for (i = 0; i < n; i++)
+		if (heap[i] != 0)
+			panic("heap[%d] isn't zero", i);
+	for (i = 0; i < n; i++)
+		heap[i] = i;
+	for (i = 0; i < n; i++)
+		if (heap[i] != i)
+			panic("heap[%d] didn't hold its value", i);
+
+	cprintf("%d pages demand-zeroed with %d faults\n", NPAGES, nfaults);
+}
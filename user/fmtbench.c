@@ -0,0 +1,53 @@
+// Time the printf formatting engine alone, without console output, on
+// the same format two ways: snprintf, which takes the output from
+// vwritefmt in runs, and printfmt, whose putch interface gets it one
+// byte at a time, as every caller did before vwritefmt.
+
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define NITER	10000
+#define FMT	"env %08x: %s at %p, %d bytes (%u%%), err %e, total %llu\n"
+#define ARGS	0x1001, "page fault", (void *) 0xeebfdff0, -4096, 75, \
+		-E_NO_MEM, 123456789012ULL
+
+struct putchbuf {
+	char *buf;
+	char *ebuf;
+};
+
+// Store one byte, as the old putch-based snprintf did.
+static void
+bufputch(int ch, struct putchbuf *b)
+{
+	if (b->buf < b->ebuf)
+		*b->buf++ = ch;
+}
+
+void
+umain(int argc, char **argv)
+{
+	char buf[128], pbuf[128];
+	struct putchbuf b;
+	uint64_t t0, t1, t2;
+	int i;
+
+	t0 = read_tsc();
+	for (i = 0; i < NITER; i++) {
+		b.buf = pbuf;
+		b.ebuf = pbuf + sizeof(pbuf) - 1;
+		printfmt((void *) bufputch, &b, FMT, ARGS);
+		*b.buf = '\0';
+	}
+	t1 = read_tsc();
+	for (i = 0; i < NITER; i++)
+		snprintf(buf, sizeof(buf), FMT, ARGS);
+	t2 = read_tsc();
+
+	if (strcmp(buf, pbuf) != 0)
+		panic("fmtbench: outputs differ:\n%s%s", pbuf, buf);
+	cprintf("%s", buf);
+	cprintf("%d formats of %d bytes\n", NITER, strlen(buf));
+	cprintf("  printfmt (putch): %llu cycles/format\n", (t1 - t0) / NITER);
+	cprintf("  snprintf (runs):  %llu cycles/format\n", (t2 - t1) / NITER);
+}
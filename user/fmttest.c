@@ -0,0 +1,20 @@
+// Check the string formats of the printf engine, and the string
+// routines under them: %s with no precision relies on strnlen(s, -1)
+// meaning no limit.
+
+#include <inc/lib.h>
+
+void
+umain(int argc, char **argv)
+{
+	char buf[64];
+
+	assert(strnlen("hello", -1) == 5);
+	assert(strnlen("hello", 3) == 3);
+	assert(snprintf(buf, sizeof(buf), "[%s]", "abc") == 5);
+	assert(strcmp(buf, "[abc]") == 0);
+	snprintf(buf, sizeof(buf), "[%5s|%-5s|%.2s|%s]", "ab", "ab", "abc", NULL);
+	assert(strcmp(buf, "[   ab|ab   |ab|(null)]") == 0);
+
+	cprintf("fmttest: OK\n");
+}
@@ -0,0 +1,25 @@
+// Use the x87 FPU and SSE registers, which makes the kernel hand
+// this env the FPU on its first floating point instruction.
+
+#include <inc/lib.h>
+
+void
+umain(int argc, char **argv)
+{
+	double sum = 0;
+	float v[4] __attribute__((aligned(16))) = { 1, 2, 3, 4 };
+	int i;
+
+	// sum 1/i^2 converges to pi^2/6 = 1.644934...
+	for (i = 1; i <= 100000; i++)
+		sum += 1.0 / ((double) i * i);
+	cprintf("sum 1/i^2 * 1e6 = %d\n", (int) (sum * 1000000));
+
+	// double each element with SSE (this file is built without
+	// SSE code generation, so the compiler never uses %xmm0)
+	asm volatile("movaps %0, %%xmm0\n\t"
+		     "addps %%xmm0, %%xmm0\n\t"
+		     "movaps %%xmm0, %0"
+		     : "+m" (v));
+	cprintf("sse: %d %d %d %d\n", (int) v[0], (int) v[1], (int) v[2], (int) v[3]);
+}
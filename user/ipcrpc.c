@@ -0,0 +1,54 @@
+// Time synchronous client/server calls over sys_ipc_call and
+// sys_ipc_reply_wait, against the cost of a null system call.
+// Each call is one trap into the server and one trap back, so the
+// round trip should approach twice the null syscall time.
+
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define NCALLS	10000
+#define STOP	((uint32_t) -1)
+
+static void
+server(void)
+{
+	envid_t client = 0;
+	uint32_t v = 0;
+
+	// The first reply_wait replies to nobody.
+	while ((v = ipc_reply_wait(client, v + 1, 0, 0, &client, 0)) != STOP)
+		;
+}
+
+void
+umain(int argc, char **argv)
+{
+	envid_t who;
+	uint64_t t0, t1, tnull;
+	uint32_t i;
+
+	if ((who = fork()) < 0)
+		panic("fork: %e", who);
+	if (who == 0) {
+		server();
+		return;
+	}
+
+	t0 = read_tsc();
+	for (i = 0; i < NCALLS; i++)
+		sys_submit();
+	t1 = read_tsc();
+	tnull = (t1 - t0) / NCALLS;
+	cprintf("null syscall: %llu cycles\n", tnull);
+
+	t0 = read_tsc();
+	for (i = 0; i < NCALLS; i++)
+		if (ipc_call(who, i, 0, 0, 0) != i + 1)
+			panic("ipcrpc: bad reply");
+	t1 = read_tsc();
+	cprintf("%d calls: %llu cycles (%llu/call, %llu null syscalls)\n",
+		NCALLS, t1 - t0, (t1 - t0) / NCALLS,
+		tnull ? (t1 - t0) / NCALLS / tnull : 0);
+
+	ipc_send(who, STOP, 0, 0);
+}
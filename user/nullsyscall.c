@@ -0,0 +1,22 @@
+// Time a loop of null system calls: sys_submit() with an empty
+// syscall ring enters the kernel and returns without doing any work.
+
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define NCALLS	10000
+
+void
+umain(int argc, char **argv)
+{
+	uint64_t t0, t1;
+	int i;
+
+	t0 = read_tsc();
+	for (i = 0; i < NCALLS; i++)
+		sys_submit();
+	t1 = read_tsc();
+
+	cprintf("%d null syscalls: %llu cycles (%llu/call)\n",
+		NCALLS, t1 - t0, (t1 - t0) / NCALLS);
+}
@@ -0,0 +1,65 @@
+// Ping-pong between a parent and a forked child over IPC.
+// First bounce a bare value back and forth to time the round trip,
+// then bounce a page to time zero-copy page transfer.
+
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define NROUNDS	1000
+#define PAGEVA	((void *) 0xa00000)
+
+static void
+report(const char *what, uint64_t cycles)
+{
+	cprintf("%d %s round trips: %llu cycles (%llu/round trip)\n",
+		NROUNDS, what, cycles, cycles / NROUNDS);
+	// Each round trip is two messages.
+	if (vdso.vd_tsc_khz && cycles)
+		cprintf("  %llu messages/sec\n",
+			2ULL * NROUNDS * vdso.vd_tsc_khz * 1000 / cycles);
+}
+
+void
+umain(int argc, char **argv)
+{
+	envid_t who;
+	uint64_t t0, t1;
+	uint32_t i;
+	int perm;
+
+	if ((who = fork()) < 0)
+		panic("fork: %e", who);
+
+	if (who == 0) {
+		// Child: echo values, then pages, back to the parent.
+		for (i = 0; i < NROUNDS; i++)
+			ipc_send(thisenv->env_parent_id,
+				 ipc_recv(0, 0, 0), 0, 0);
+		for (i = 0; i < NROUNDS; i++) {
+			ipc_recv(0, PAGEVA, &perm);
+			ipc_send(thisenv->env_parent_id, i, PAGEVA, perm);
+		}
+		return;
+	}
+
+	t0 = read_tsc();
+	for (i = 0; i < NROUNDS; i++) {
+		ipc_send(who, i, 0, 0);
+		if (ipc_recv(0, 0, 0) != i)
+			panic("pingpong: bad value");
+	}
+	t1 = read_tsc();
+	report("value", t1 - t0);
+
+	if ((perm = sys_page_alloc(0, PAGEVA, PTE_P | PTE_U | PTE_W)) < 0)
+		panic("sys_page_alloc: %e", perm);
+	t0 = read_tsc();
+	for (i = 0; i < NROUNDS; i++) {
+		ipc_send(who, i, PAGEVA, PTE_P | PTE_U | PTE_W);
+		ipc_recv(0, PAGEVA, &perm);
+		if (!(perm & PTE_P))
+			panic("pingpong: no page received");
+	}
+	t1 = read_tsc();
+	report("page", t1 - t0);
+}
@@ -0,0 +1,80 @@
+// Time the lib/string.c routines over a sweep of sizes and source
+// alignments.  Each line reports cycles per call.
+
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define MAXSIZE	4096
+#define NBYTES	(1 << 20)	// bytes processed per measurement
+
+static char src[MAXSIZE + 64] __attribute__((aligned(64)));
+static char dst[MAXSIZE + 64] __attribute__((aligned(64)));
+static char cmp[MAXSIZE + 64] __attribute__((aligned(64)));
+
+static const size_t sizes[] = { 8, 64, 512, MAXSIZE };
+static const int aligns[] = { 0, 1, 3 };
+
+#define NSIZES	(sizeof(sizes) / sizeof(sizes[0]))
+#define NALIGNS	(sizeof(aligns) / sizeof(aligns[0]))
+
+enum { STRLEN, STRNLEN, STRCHR, STRCMP, MEMCMP, MEMFIND, MEMCPY, MEMMOVE,
+       NROUTINES };
+
+static const char *names[NROUTINES] = {
+	"strlen", "strnlen", "strchr", "strcmp",
+	"memcmp", "memfind", "memcpy", "memmove",
+};
+
+// Run routine r n times on size-byte strings at alignment a and
+// return the cycles per call.  Results feed 'sink' so nothing is
+// optimized away.
+static volatile uintptr_t sink;
+
+static uint64_t
+run(int r, size_t size, int a, int n)
+{
+	char *s = src + a, *t = cmp + a, *d = dst + (a ^ 1);
+	uint64_t t0;
+	uintptr_t x = 0;
+	int i;
+
+	memset(src, 'x', sizeof(src));
+	memset(cmp, 'x', sizeof(cmp));
+	s[size - 1] = t[size - 1] = '\0';
+
+	t0 = read_tsc();
+	for (i = 0; i < n; i++) {
+		switch (r) {
+		case STRLEN:	x += strlen(s); break;
+		case STRNLEN:	x += strnlen(s, size); break;
+		case STRCHR:	x += (uintptr_t) strchr(s, 'y'); break;
+		case STRCMP:	x += strcmp(s, t); break;
+		case MEMCMP:	x += memcmp(s, t, size); break;
+		case MEMFIND:	x += (uintptr_t) memfind(s, 'y', size); break;
+		case MEMCPY:	x += (uintptr_t) memcpy(d, s, size); break;
+		case MEMMOVE:	x += (uintptr_t) memmove(s + 1, s, size - 1); break;
+		}
+	}
+	sink = x;
+	return (read_tsc() - t0) / n;
+}
+
+void
+umain(int argc, char **argv)
+{
+	int r, i, j;
+
+	cprintf("%-8s", "cycles");
+	for (i = 0; i < NSIZES; i++)
+		for (j = 0; j < NALIGNS; j++)
+			cprintf(" %5d+%d", sizes[i], aligns[j]);
+	cprintf("\n");
+	for (r = 0; r < NROUTINES; r++) {
+		cprintf("%-8s", names[r]);
+		for (i = 0; i < NSIZES; i++)
+			for (j = 0; j < NALIGNS; j++)
+				cprintf(" %7llu", run(r, sizes[i], aligns[j],
+						      NBYTES / sizes[i]));
+		cprintf("\n");
+	}
+}
@@ -0,0 +1,56 @@
+// Compare 10000 individual system calls against the same calls
+// submitted in batches through the syscall ring, and against
+// reading the envid from the UVDSO page.
+
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define NCALLS	10000
+
+// SYS_getenvid is cheap and has no side effects.  The library's
+// sys_getenvid reads the UVDSO page instead, so trap here directly.
+static envid_t
+trap_getenvid(void)
+{
+	envid_t ret;
+
+	asm volatile("int %1"
+		     : "=a" (ret)
+		     : "i" (T_SYSCALL), "a" (SYS_getenvid)
+		     : "cc", "memory");
+	return ret;
+}
+
+void
+umain(int argc, char **argv)
+{
+	uint64_t t0, t1, t2, t3;
+	int32_t ret;
+	int i;
+
+	t0 = read_tsc();
+	for (i = 0; i < NCALLS; i++)
+		trap_getenvid();
+	t1 = read_tsc();
+
+	for (i = 0; i < NCALLS; ) {
+		for (; i < NCALLS; i++)
+			if (sysring_queue(SYS_getenvid, 0, 0, 0, 0, 0, i) < 0)
+				break;
+		sys_submit();
+		while (sysring_reap(&ret, 0) == 0)
+			/* do nothing */;
+	}
+	t2 = read_tsc();
+
+	for (i = 0; i < NCALLS; i++)
+		sys_getenvid();
+	t3 = read_tsc();
+
+	cprintf("%d individual getenvid: %llu cycles (%llu/call)\n",
+		NCALLS, t1 - t0, (t1 - t0) / NCALLS);
+	cprintf("%d batched getenvid:    %llu cycles (%llu/call)\n",
+		NCALLS, t2 - t1, (t2 - t1) / NCALLS);
+	cprintf("%d vdso getenvid:       %llu cycles (%llu/call)\n",
+		NCALLS, t3 - t2, (t3 - t2) / NCALLS);
+}
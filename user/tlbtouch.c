@@ -0,0 +1,42 @@
+// Touch one word in each of NPAGES pages, with and without a system
+// call between passes.  If returning from the kernel flushed the TLB,
+// every pass after a system call would take NPAGES TLB misses.
+
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define NPAGES	64
+#define NPASSES	2000
+
+static uint8_t buf[NPAGES * PGSIZE];
+
+static uint64_t
+run(bool syscalls)
+{
+	uint64_t t0;
+	int i, j;
+
+	t0 = read_tsc();
+	for (i = 0; i < NPASSES; i++) {
+		for (j = 0; j < NPAGES; j++)
+			buf[j * PGSIZE]++;
+		if (syscalls)
+			sys_submit();
+	}
+	return read_tsc() - t0;
+}
+
+void
+umain(int argc, char **argv)
+{
+	uint64_t quiet, busy;
+
+	run(0);		// warm up the caches and TLB
+	quiet = run(0);
+	busy = run(1);
+
+	cprintf("%d passes over %d pages: %llu cycles/pass\n",
+		NPASSES, NPAGES, quiet / NPASSES);
+	cprintf("same, one syscall per pass: %llu cycles/pass\n",
+		busy / NPASSES);
+}